@@ -0,0 +1,333 @@
+// Runs the sql/bench_*.sql scenarios headless at increasing entity counts
+// and writes frame times, per-statement costs and memory use as CSV.
+// With --worlds N it instead runs 1, 2, 4 ... N independent copies of each scenario
+// on as many threads and reports aggregate frames/sec against thread count.
+#include <sqlite3.h>
+#include <sql_bindings.h>
+#include <script.h>
+#include <update_fusion.h>
+#include <host_params.h>
+#include <auto_analyze.h>
+#include <query_plans.h>
+#include <logger.h>
+#include <frame.h>
+#include <page_cache.h>
+#include <filesystem>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <barrier>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+
+namespace fs = std::filesystem;
+namespace rn = std::ranges;
+
+struct Options {
+    int frames = 60;
+    int worlds = 0;
+    double max_frame_ms = 1000;
+    int64_t seed = 1;
+    std::vector<int64_t> sizes = {1000, 10000, 100000, 1000000};
+    std::string out_dir = ".";
+    std::vector<std::string> scripts;
+    std::vector<std::string> page_caches = {"default"};
+    bool fuse_updates = false;
+    int auto_analyze = sqhell::AutoAnalyze().interval;
+};
+
+struct RunResult {
+    int frames;
+    int64_t live_entities;
+    double avg_frame_ms, max_frame_ms;
+    int64_t memory, memory_highwater;
+};
+
+std::string csv_quote(const char *s) {
+    std::string out = "\"";
+    for(; *s && *s != '\n'; ++s) {
+        if(*s == '"') out += '"';
+        out += *s;
+    }
+    return out + "\"";
+}
+
+int64_t query_int(sqlite3 *db, const char *sql) {
+    sqlite3_stmt *stmt;
+    int64_t result = -1;
+    if(sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) return result;
+    if(sqlite3_step(stmt) == SQLITE_ROW) result = sqlite3_column_int64(stmt, 0);
+    sqlite3_finalize(stmt);
+    return result;
+}
+
+// Headless scenarios run on a fixed time step, frame 0 being the one that loads the script
+constexpr double FRAME_DT = 1.0 / 60;
+
+void set_bench_frame(sqlite3 *db, int frame) {
+    sqhell::set_frame_params(db, frame * FRAME_DT, FRAME_DT, frame);
+}
+
+// Opens a fresh in-memory database with the bench(entities, seed) table the scenarios read
+sqlite3 *open_world(int64_t size, int64_t seed) {
+    sqlite3 *db;
+    if(sqlite3_open_v2(":memory:", &db, SQLITE_OPEN_READWRITE|SQLITE_OPEN_CREATE, nullptr) != SQLITE_OK) {
+        fprintf(stderr, "Failed to open database\n");
+        exit(EXIT_FAILURE);
+    }
+    sqhell::init_sql_bindings(db);
+
+    char setup[128];
+    snprintf(setup, sizeof(setup), "create table bench(entities int, seed int); insert into bench values(%lld, %lld);",
+        (long long) size, (long long) seed);
+    sqlite3_exec(db, setup, nullptr, nullptr, nullptr);
+    set_bench_frame(db, 0);
+    return db;
+}
+
+void close_world(sqlite3 *db, sqhell::Script &script) {
+    for(auto &s : script.statements) sqlite3_finalize(s.stmt);
+    sqlite3_close(db);
+}
+
+RunResult run_scenario(const Options &opt, const std::string &path, int64_t size, const std::string &page_cache, FILE *stmt_csv) {
+    auto db = open_world(size, opt.seed);
+    sqlite3_memory_highwater(1);
+    auto script = sqhell::load_sql_script(db, path.c_str());
+    if(opt.fuse_updates) sqhell::fuse_updates(db, script);
+    script.profile = true;
+    sqhell::AutoAnalyze analyze{opt.auto_analyze};
+
+    RunResult result{0, 0, 0, 0, 0, 0};
+    double total_ms = 0;
+    for(int frame = 0; frame < opt.frames; ++frame) {
+        auto begin = std::chrono::steady_clock::now();
+        set_bench_frame(db, frame + 1);
+        sqhell::run_script(db, script);
+        sqhell::auto_analyze_end_frame(db, script, analyze);
+        sqhell::end_frame();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+
+        total_ms += ms;
+        result.max_frame_ms = std::max(result.max_frame_ms, ms);
+        result.frames++;
+        // a single frame over budget means larger sizes won't finish either
+        if(ms > opt.max_frame_ms) break;
+    }
+    result.avg_frame_ms = total_ms / result.frames;
+    result.memory = sqlite3_memory_used();
+    result.memory_highwater = sqlite3_memory_highwater(0);
+    // pooled scenarios keep dead slots in the table
+    result.live_entities = query_int(db, "select count(*) from entities where alive");
+    if(result.live_entities < 0) result.live_entities = query_int(db, "select count(*) from entities");
+
+    auto name = fs::path(path).stem().string();
+    for(size_t i = 0; i < script.statements.size(); ++i) {
+        auto &s = script.statements[i];
+        // @repeat blocks have no statement, their row covers every pass over the block
+        char repeat[96];
+        if(!s.stmt) snprintf(repeat, sizeof(repeat), "-- @repeat max=%d (%.2f passes per run)",
+            s.max_iterations, (double) s.iterations / std::max<uint64_t>(s.runs, 1));
+        fprintf(stmt_csv, "%s,%lld,%s,%zu,%d,%.3f,%.2f,%s\n",
+            name.c_str(), (long long) size, page_cache.c_str(), i, s.line,
+            s.seconds * 1e6 / std::max<uint64_t>(s.runs, 1),
+            s.seconds * 1e3 / total_ms * 100,
+            csv_quote(s.stmt ? sqlite3_sql(s.stmt) : repeat).c_str());
+    }
+
+    close_world(db, script);
+    return result;
+}
+
+// Runs `threads` worlds of the scenario in parallel, each with its own database and seed.
+// Returns the wall time of the frames in seconds, loading the scripts is not included.
+double run_worlds(const Options &opt, const std::string &path, int64_t size, int threads) {
+    std::barrier sync(threads + 1);
+    std::vector<std::thread> workers;
+    for(int i = 0; i < threads; ++i) {
+        workers.emplace_back([&, i] {
+            auto db = open_world(size, opt.seed + i);
+            auto script = sqhell::load_sql_script(db, path.c_str());
+            if(opt.fuse_updates) sqhell::fuse_updates(db, script);
+            sqhell::AutoAnalyze analyze{opt.auto_analyze};
+            sqhell::end_world_frame();
+            sync.arrive_and_wait();
+            for(int frame = 0; frame < opt.frames; ++frame) {
+                set_bench_frame(db, frame + 1);
+                sqhell::run_script(db, script);
+                sqhell::auto_analyze_end_frame(db, script, analyze);
+                sqhell::end_world_frame();
+            }
+            sync.arrive_and_wait();
+            close_world(db, script);
+        });
+    }
+    sync.arrive_and_wait();
+    auto begin = std::chrono::steady_clock::now();
+    sync.arrive_and_wait();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    for(auto &w : workers) w.join();
+    return seconds;
+}
+
+void run_scaling(const Options &opt) {
+    auto worlds_path = fs::path(opt.out_dir) / "bench_worlds.csv";
+    FILE *csv = fopen(worlds_path.c_str(), "w");
+    if(!csv) {
+        fprintf(stderr, "Failed to open output files in %s\n", opt.out_dir.c_str());
+        exit(EXIT_FAILURE);
+    }
+    fprintf(csv, "scenario,size,threads,frames,seconds,frames_per_second,efficiency\n");
+
+    int64_t size = opt.sizes.front();
+    printf("%-24s %10s %8s %14s %14s %11s\n", "scenario", "size", "threads", "frames/s", "per thread", "efficiency");
+    for(auto &path : opt.scripts) {
+        auto name = fs::path(path).stem().string();
+        double single = 0;
+        for(int threads = 1;; threads = std::min(threads * 2, opt.worlds)) {
+            double seconds = run_worlds(opt, path, size, threads);
+            double fps = threads * opt.frames / seconds;
+            if(threads == 1) single = fps;
+            // 1.0 means every added thread ran as fast as a lone world
+            double efficiency = fps / (single * threads);
+            fprintf(csv, "%s,%lld,%d,%d,%.6f,%.2f,%.3f\n",
+                name.c_str(), (long long) size, threads, threads * opt.frames, seconds, fps, efficiency);
+            printf("%-24s %10lld %8d %14.1f %14.1f %10.0f%%\n",
+                name.c_str(), (long long) size, threads, fps, fps / threads, efficiency * 100);
+            fflush(stdout);
+            if(threads == opt.worlds) break;
+        }
+    }
+
+    fclose(csv);
+    printf("Results written to %s\n", worlds_path.c_str());
+}
+
+std::vector<std::string> parse_names(const char *list) {
+    std::vector<std::string> names;
+    for(const char *p = list; *p;) {
+        const char *end = strchr(p, ',');
+        if(!end) end = p + strlen(p);
+        if(end > p) names.emplace_back(p, end);
+        p = *end ? end+1 : end;
+    }
+    return names;
+}
+
+// SQLite has to be shut down to switch page caches, all connections must be closed
+void select_page_cache(const std::string &name) {
+    sqlite3_shutdown();
+    if(!sqhell::use_slab_page_cache(name == "slab")) {
+        fprintf(stderr, "Failed to switch to the %s page cache\n", name.c_str());
+        exit(EXIT_FAILURE);
+    }
+}
+
+std::vector<int64_t> parse_sizes(const char *list) {
+    std::vector<int64_t> sizes;
+    const char *p = list;
+    while(*p) {
+        char *end;
+        long long size = strtoll(p, &end, 10);
+        if(end == p) break;
+        sizes.push_back(size);
+        p = *end == ',' ? end+1 : end;
+    }
+    return sizes;
+}
+
+int main(int argc, char **argv) {
+    Options opt;
+    for(int i = 1; i < argc; ++i) {
+        if(strcmp(argv[i], "--frames") == 0 && i+1 < argc) opt.frames = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--worlds") == 0 && i+1 < argc) opt.worlds = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--pcache") == 0 && i+1 < argc) opt.page_caches = parse_names(argv[++i]);
+        else if(strcmp(argv[i], "--sizes") == 0 && i+1 < argc) opt.sizes = parse_sizes(argv[++i]);
+        else if(strcmp(argv[i], "--max-frame-ms") == 0 && i+1 < argc) opt.max_frame_ms = atof(argv[++i]);
+        else if(strcmp(argv[i], "--seed") == 0 && i+1 < argc) opt.seed = atoll(argv[++i]);
+        else if(strcmp(argv[i], "--out") == 0 && i+1 < argc) opt.out_dir = argv[++i];
+        else if(strcmp(argv[i], "--fuse-updates") == 0) opt.fuse_updates = true;
+        else if(strcmp(argv[i], "--strict-hot-plans") == 0) sqhell::set_strict_hot_plans(true);
+        else if(strcmp(argv[i], "--auto-analyze") == 0 && i+1 < argc) opt.auto_analyze = atoi(argv[++i]);
+        else if(argv[i][0] == '-') {
+            fprintf(stderr, "Usage: %s [--frames N] [--worlds N] [--pcache slab,default] [--sizes 1000,10000,...] [--max-frame-ms MS] [--seed N] [--out dir] [--fuse-updates] [--auto-analyze <frames>] [--strict-hot-plans] [scripts...]\n", *argv);
+            return EXIT_FAILURE;
+        }
+        else opt.scripts.push_back(argv[i]);
+    }
+    if(opt.scripts.empty()) {
+        for(auto &entry : fs::directory_iterator("sql")) {
+            auto name = entry.path().filename().string();
+            if(name.starts_with("bench_") && name.ends_with(".sql")) opt.scripts.push_back(entry.path().string());
+        }
+        rn::sort(opt.scripts);
+    }
+    for(auto &name : opt.page_caches) {
+        if(name != "slab" && name != "default") {
+            fprintf(stderr, "Unknown page cache: %s\n", name.c_str());
+            return EXIT_FAILURE;
+        }
+    }
+    if(opt.scripts.empty() || opt.sizes.empty() || opt.frames <= 0 || opt.page_caches.empty()) {
+        fprintf(stderr, "Nothing to run\n");
+        return EXIT_FAILURE;
+    }
+
+    if(opt.worlds > 0) {
+        // each connection stays on its thread, and the global memory statistics
+        // would otherwise serialize every allocation across worlds
+        sqlite3_config(SQLITE_CONFIG_MULTITHREAD);
+        sqlite3_config(SQLITE_CONFIG_MEMSTATUS, 0);
+    }
+    sqhell::use_slab_page_cache(opt.page_caches.front() == "slab");
+    sqhell::start_logger(nullptr);
+    sqhell::set_log_level(sqhell::LOG_WARN);
+
+    fs::create_directories(opt.out_dir);
+    if(opt.worlds > 0) {
+        run_scaling(opt);
+        return 0;
+    }
+
+    auto frames_path = fs::path(opt.out_dir) / "bench_frames.csv";
+    auto stmts_path = fs::path(opt.out_dir) / "bench_statements.csv";
+    FILE *frames_csv = fopen(frames_path.c_str(), "w");
+    FILE *stmt_csv = fopen(stmts_path.c_str(), "w");
+    if(!frames_csv || !stmt_csv) {
+        fprintf(stderr, "Failed to open output files in %s\n", opt.out_dir.c_str());
+        return EXIT_FAILURE;
+    }
+    fprintf(frames_csv, "scenario,size,page_cache,live_entities,frames,avg_frame_ms,max_frame_ms,memory_bytes,memory_highwater_bytes\n");
+    fprintf(stmt_csv, "scenario,size,page_cache,statement,line,avg_us,frame_share_percent,sql\n");
+
+    // memory doesn't include pages held by the slab cache, those are mapped outside of SQLite's allocator
+    printf("%-24s %10s %8s %10s %8s %12s %12s %12s\n", "scenario", "size", "pcache", "entities", "frames", "avg ms", "max ms", "memory KiB");
+    for(auto &path : opt.scripts) {
+        auto name = fs::path(path).stem().string();
+        for(auto size : opt.sizes) {
+            bool over_budget = false;
+            for(auto &page_cache : opt.page_caches) {
+                if(opt.page_caches.size() > 1) select_page_cache(page_cache);
+                auto r = run_scenario(opt, path, size, page_cache, stmt_csv);
+                fprintf(frames_csv, "%s,%lld,%s,%lld,%d,%.3f,%.3f,%lld,%lld\n",
+                    name.c_str(), (long long) size, page_cache.c_str(), (long long) r.live_entities, r.frames,
+                    r.avg_frame_ms, r.max_frame_ms, (long long) r.memory, (long long) r.memory_highwater);
+                printf("%-24s %10lld %8s %10lld %8d %12.3f %12.3f %12lld\n",
+                    name.c_str(), (long long) size, page_cache.c_str(), (long long) r.live_entities, r.frames,
+                    r.avg_frame_ms, r.max_frame_ms, (long long) r.memory_highwater / 1024);
+                fflush(stdout);
+                over_budget |= r.frames < opt.frames;
+            }
+            if(over_budget) {
+                printf("%-24s stopped scaling: a frame took over %.0f ms\n", name.c_str(), opt.max_frame_ms);
+                break;
+            }
+        }
+    }
+
+    fclose(frames_csv);
+    fclose(stmt_csv);
+    printf("Results written to %s and %s\n", frames_path.c_str(), stmts_path.c_str());
+}
@@ -0,0 +1,198 @@
+// Measures the overhead of individual SQL bindings by calling them from real SQL statements.
+// Each case runs a query over N generated rows; the cost of the same query without
+// the call is subtracted, leaving nanoseconds per call.
+// Usage: sqhell_microbench [--iterations N] [--repeat N] [--baseline <csv>] [--save]
+//   --baseline compares against the CSV if it exists, otherwise (or with --save) writes it.
+#include <sqlite3.h>
+#include <sql_bindings.h>
+#include <logger.h>
+#include <frame.h>
+#include <imgui/imgui.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <map>
+#include <cstring>
+#include <cstdio>
+
+struct Case {
+    const char *name;
+    int args;
+    const char *expr;   // evaluated once per row, `i` is the row number
+    const char *after;  // optional statement run after each pass, not measured
+};
+
+const Case cases[] = {
+    {"benchNoop/0",              0,  "benchNoop()", nullptr},
+    {"benchNoop/8",              8,  "benchNoop(i,i,i,i,i,i,i,i)", nullptr},
+    {"GL_FLOAT",                 0,  "GL_FLOAT()", nullptr},
+    {"randomFloat",              0,  "randomFloat()", nullptr},
+    {"randomFloat/2",            2,  "randomFloat(0, i)", nullptr},
+    {"pushFloats/1",             1,  "pushFloats(i)", "select clearFloats()"},
+    {"pushFloats/6",             6,  "pushFloats(i,i,i,i,i,i)", "select clearFloats()"},
+    {"pushFloats/36",            36, "pushFloats(i,i,i,i,i,i,i,i,i,i,i,i,i,i,i,i,i,i,i,i,i,i,i,i,i,i,i,i,i,i,i,i,i,i,i,i)", "select clearFloats()"},
+    {"pushFloats/36 (real)",     36, "pushFloats(r,r,r,r,r,r,r,r,r,r,r,r,r,r,r,r,r,r,r,r,r,r,r,r,r,r,r,r,r,r,r,r,r,r,r,r)", "select clearFloats()"},
+    {"getFloats",                0,  "getFloats()", nullptr},
+    {"emitRect",                 8,  "emitRect(r,r,r,r,r,r,r,r)", "select clearDrawList()"},
+    {"emitQuad",                 12, "emitQuad(r,r,r,r,r,r,r,r,r,r,r,r)", "select clearDrawList()"},
+    {"logMessage (filtered)",    2,  "logMessage('debug', i)", nullptr},
+    {"print",                    1,  "print(i)", nullptr},
+    {"readFileText (cached)",    1,  "readFileText('shaders/color.vert')", nullptr},
+    {"eval",                     1,  "eval('select 1')", nullptr},
+    {"ImGuiLabel",               2,  "ImGuiLabel('label', i)", nullptr},
+    {"ImGuiButton",              1,  "ImGuiButton('button')", nullptr},
+    {"ImGuiInputTextMultiline",  2,  "ImGuiInputTextMultiline('input', 'text')", nullptr},
+};
+
+struct Result {
+    double ns_per_call;
+    double ns_per_arg;
+};
+
+void bench_noop(sqlite3_context *ctx, int argc, sqlite3_value **argv) {}
+
+sqlite3_stmt *prepare(sqlite3 *db, const std::string &sql) {
+    sqlite3_stmt *stmt;
+    if(sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        fprintf(stderr, "ERROR: %s\n%s\n", sqlite3_errmsg(db), sql.c_str());
+        exit(EXIT_FAILURE);
+    }
+    return stmt;
+}
+
+// Runs the query and returns the time it took in ns
+double run(sqlite3 *db, sqlite3_stmt *stmt) {
+    auto begin = std::chrono::steady_clock::now();
+    while(sqlite3_step(stmt) == SQLITE_ROW);
+    auto end = std::chrono::steady_clock::now();
+    if(sqlite3_reset(stmt) != SQLITE_OK) {
+        fprintf(stderr, "ERROR: %s\n", sqlite3_errmsg(db));
+        exit(EXIT_FAILURE);
+    }
+    return std::chrono::duration<double, std::nano>(end - begin).count();
+}
+
+// ImGui without a window, so the ImGui bindings have a frame to draw into
+void begin_imgui_frame() {
+    ImGui::NewFrame();
+    ImGui::Begin("microbench");
+}
+
+void end_imgui_frame() {
+    ImGui::End();
+    ImGui::EndFrame();
+}
+
+std::map<std::string, Result> read_baseline(const char *path) {
+    std::map<std::string, Result> baseline;
+    FILE *f = fopen(path, "r");
+    if(!f) return baseline;
+    char line[512];
+    fgets(line, sizeof(line), f); // header
+    while(fgets(line, sizeof(line), f)) {
+        char *comma = strrchr(line, ',');
+        if(!comma) continue;
+        *comma = '\0';
+        char *comma2 = strrchr(line, ',');
+        if(!comma2) continue;
+        *comma2 = '\0';
+        baseline[line] = {atof(comma2+1), atof(comma+1)};
+    }
+    fclose(f);
+    return baseline;
+}
+
+int main(int argc, char **argv) {
+    int iterations = 100000;
+    int repeat = 5;
+    const char *baseline_path = nullptr;
+    bool save = false;
+    for(int i = 1; i < argc; ++i) {
+        if(strcmp(argv[i], "--iterations") == 0 && i+1 < argc) iterations = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--repeat") == 0 && i+1 < argc) repeat = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--baseline") == 0 && i+1 < argc) baseline_path = argv[++i];
+        else if(strcmp(argv[i], "--save") == 0) save = true;
+        else {
+            fprintf(stderr, "Usage: %s [--iterations N] [--repeat N] [--baseline <csv>] [--save]\n", *argv);
+            return EXIT_FAILURE;
+        }
+    }
+
+    sqhell::start_logger("/dev/null");
+    sqhell::set_log_level(sqhell::LOG_WARN);
+
+    ImGui::CreateContext();
+    ImGuiIO &io = ImGui::GetIO();
+    io.DisplaySize = ImVec2(1280, 720);
+    io.IniFilename = nullptr;
+    unsigned char *pixels;
+    int w, h;
+    io.Fonts->GetTexDataAsRGBA32(&pixels, &w, &h);
+
+    sqlite3 *db;
+    sqlite3_open_v2(":memory:", &db, SQLITE_OPEN_READWRITE|SQLITE_OPEN_CREATE, nullptr);
+    sqhell::init_sql_bindings(db);
+    sqlite3_create_function(db, "benchNoop", -1, SQLITE_UTF8, nullptr, bench_noop, nullptr, nullptr);
+
+    // rows come from a table so the generator's cost doesn't drown out cheap calls
+    sqlite3_exec(db, "create table n(i integer primary key, r real)", nullptr, nullptr, nullptr);
+    std::string fill = "insert into n with recursive c(i) as (select 1 union all select i+1 from c limit "
+        + std::to_string(iterations) + ") select i, i*0.5 from c";
+    sqlite3_exec(db, fill.c_str(), nullptr, nullptr, nullptr);
+
+    auto empty = prepare(db, "select count(1) from n");
+    double empty_ns = 1e300;
+    for(int r = 0; r < repeat; ++r) empty_ns = std::min(empty_ns, run(db, empty));
+    sqlite3_finalize(empty);
+
+    auto baseline = baseline_path ? read_baseline(baseline_path) : std::map<std::string, Result>{};
+    bool compare = !baseline.empty() && !save;
+
+    printf("%d rows, empty scan %.2f ns/row\n", iterations, empty_ns / iterations);
+    printf("%-26s %5s %12s %12s%s\n", "binding", "args", "ns/call", "ns/arg", compare ? "   vs baseline" : "");
+
+    std::vector<std::pair<std::string, Result>> results;
+    for(auto &c : cases) {
+        auto stmt = prepare(db, std::string("select count(") + c.expr + ") from n");
+        auto after = c.after ? prepare(db, c.after) : nullptr;
+
+        double best = 1e300;
+        for(int r = 0; r < repeat; ++r) {
+            begin_imgui_frame();
+            best = std::min(best, run(db, stmt));
+            end_imgui_frame();
+            if(after) run(db, after);
+            // releases the scratch strings returned by eval() etc.
+            sqhell::end_world_frame();
+        }
+        sqlite3_finalize(stmt);
+        sqlite3_finalize(after);
+
+        Result res;
+        res.ns_per_call = std::max(0.0, best - empty_ns) / iterations;
+        res.ns_per_arg = c.args ? res.ns_per_call / c.args : 0;
+        results.push_back({c.name, res});
+
+        printf("%-26s %5d %12.2f %12.2f", c.name, c.args, res.ns_per_call, res.ns_per_arg);
+        auto it = baseline.find(c.name);
+        if(compare && it != baseline.end() && it->second.ns_per_call > 0)
+            printf("   %+8.1f%%", (res.ns_per_call / it->second.ns_per_call - 1) * 100);
+        printf("\n");
+    }
+
+    if(baseline_path && (save || baseline.empty())) {
+        FILE *f = fopen(baseline_path, "w");
+        if(!f) {
+            fprintf(stderr, "Failed to write %s\n", baseline_path);
+            return EXIT_FAILURE;
+        }
+        fprintf(f, "binding,ns_per_call,ns_per_arg\n");
+        for(auto &[name, res] : results) fprintf(f, "%s,%.3f,%.3f\n", name.c_str(), res.ns_per_call, res.ns_per_arg);
+        fclose(f);
+        printf("Baseline saved to %s\n", baseline_path);
+    }
+
+    sqlite3_close(db);
+    ImGui::DestroyContext();
+}
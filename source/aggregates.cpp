@@ -0,0 +1,570 @@
+#include <aggregates.h>
+#include <snapshot.h>
+#include <sqlite3.h>
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+namespace sqhell {
+
+// Group key, ordered like SQLite sorts values: null, numbers, text, blobs.
+// Integral reals are stored as integers, so 1 and 1.0 land in the same group.
+struct Key {
+    int type = SQLITE_NULL;
+    int64_t i = 0;
+    double d = 0;
+    std::string bytes;
+
+    bool operator==(const Key &) const = default;
+};
+
+int type_rank(int type) {
+    switch(type) {
+        case SQLITE_NULL: return 0;
+        case SQLITE_INTEGER: case SQLITE_FLOAT: return 1;
+        case SQLITE_TEXT: return 2;
+        default: return 3;
+    }
+}
+
+struct KeyLess {
+    bool operator()(const Key &a, const Key &b) const {
+        int ra = type_rank(a.type), rb = type_rank(b.type);
+        if(ra != rb) return ra < rb;
+        if(ra == 1) {
+            if(a.type == SQLITE_INTEGER && b.type == SQLITE_INTEGER) return a.i < b.i;
+            double x = a.type == SQLITE_INTEGER ? (double) a.i : a.d;
+            double y = b.type == SQLITE_INTEGER ? (double) b.i : b.d;
+            return x < y;
+        }
+        return a.bytes < b.bytes;
+    }
+};
+
+Key make_key(sqlite3_value *v) {
+    Key key;
+    key.type = sqlite3_value_type(v);
+    switch(key.type) {
+        case SQLITE_INTEGER: key.i = sqlite3_value_int64(v); break;
+        case SQLITE_FLOAT:
+            key.d = sqlite3_value_double(v);
+            if(key.d == std::trunc(key.d) && std::abs(key.d) < 9.2e18) {
+                key.type = SQLITE_INTEGER;
+                key.i = (int64_t) key.d;
+                key.d = 0;
+            }
+            break;
+        case SQLITE_TEXT: key.bytes.assign((const char*) sqlite3_value_text(v), sqlite3_value_bytes(v)); break;
+        case SQLITE_BLOB: key.bytes.assign((const char*) sqlite3_value_blob(v), sqlite3_value_bytes(v)); break;
+    }
+    return key;
+}
+
+void result_key(sqlite3_context *ctx, const Key &key) {
+    switch(key.type) {
+        case SQLITE_INTEGER: sqlite3_result_int64(ctx, key.i); break;
+        case SQLITE_FLOAT: sqlite3_result_double(ctx, key.d); break;
+        case SQLITE_TEXT: sqlite3_result_text(ctx, key.bytes.data(), key.bytes.size(), SQLITE_TRANSIENT); break;
+        case SQLITE_BLOB: sqlite3_result_blob(ctx, key.bytes.data(), key.bytes.size(), SQLITE_TRANSIENT); break;
+        default: sqlite3_result_null(ctx);
+    }
+}
+
+struct Group {
+    int64_t rows = 0;
+    int64_t values = 0;         // non-null values summed
+    int64_t real_values = 0;
+    int64_t int_sum = 0;
+    double real_sum = 0;
+};
+
+enum TermKind { TERM_TRUE, TERM_FALSE, TERM_NOT_NULL, TERM_EQUALS };
+
+struct Term {
+    int column;
+    TermKind kind;
+    double value;   // TERM_EQUALS
+};
+
+// What one row adds to the aggregate
+struct Contribution {
+    bool matched = false;
+    Key key;
+    int value_type = SQLITE_NULL;
+    int64_t int_value = 0;
+    double real_value = 0;
+
+    bool operator==(const Contribution &) const = default;
+};
+
+struct Aggregate {
+    std::string name, table, definition;
+    bool sum = false;           // otherwise count(*)
+    int value_column = -1;
+    bool real_column = false;   // REAL affinity, whose integral values may be stored as integers
+    int group_column = -1;
+    std::vector<Term> filter;
+    Group total;
+    std::map<Key, Group, KeyLess> groups;
+};
+
+// Columns any aggregate over the table reads
+struct WatchedTable {
+    std::string table;
+    std::vector<int> columns;
+};
+
+// One set per connection
+struct Aggregates {
+    std::vector<std::unique_ptr<Aggregate>> list;
+    std::vector<WatchedTable> tables;
+    uint64_t restores = 0;      // snapshot_restores() when they were last rebuilt
+    bool hooked = false;
+};
+
+bool truthy(sqlite3_value *v) {
+    switch(sqlite3_value_type(v)) {
+        case SQLITE_NULL: return false;
+        case SQLITE_INTEGER: return sqlite3_value_int64(v) != 0;
+        default: return sqlite3_value_double(v) != 0;
+    }
+}
+
+bool term_matches(const Term &term, sqlite3_value *v) {
+    int type = sqlite3_value_type(v);
+    switch(term.kind) {
+        case TERM_TRUE: return truthy(v);
+        case TERM_FALSE: return type != SQLITE_NULL && !truthy(v);
+        case TERM_NOT_NULL: return type != SQLITE_NULL;
+        case TERM_EQUALS: return (type == SQLITE_INTEGER || type == SQLITE_FLOAT) && sqlite3_value_double(v) == term.value;
+    }
+    return false;
+}
+
+// `column(i)` returns the row's value of table column i
+template<class Column>
+Contribution contribution(const Aggregate &agg, Column column) {
+    Contribution c;
+    for(auto &term : agg.filter)
+        if(!term_matches(term, column(term.column))) return c;
+    c.matched = true;
+    if(agg.group_column >= 0) c.key = make_key(column(agg.group_column));
+    if(agg.sum) {
+        sqlite3_value *v = column(agg.value_column);
+        c.value_type = sqlite3_value_type(v);
+        if(c.value_type == SQLITE_INTEGER && agg.real_column) c.value_type = SQLITE_FLOAT;
+        if(c.value_type == SQLITE_INTEGER) c.int_value = sqlite3_value_int64(v);
+        else if(c.value_type != SQLITE_NULL) c.real_value = sqlite3_value_double(v);
+    }
+    return c;
+}
+
+void apply_group(Group &group, const Contribution &c, int sign) {
+    group.rows += sign;
+    if(c.value_type == SQLITE_NULL) return;
+    group.values += sign;
+    if(c.value_type == SQLITE_INTEGER) {
+        group.int_sum += sign * c.int_value;
+    } else {
+        group.real_values += sign;
+        group.real_sum += sign * c.real_value;
+        // don't let rounding errors outlive the values that caused them
+        if(group.real_values == 0) group.real_sum = 0;
+    }
+}
+
+void apply(Aggregate &agg, const Contribution &c, int sign) {
+    if(!c.matched) return;
+    apply_group(agg.total, c, sign);
+    if(agg.group_column < 0) return;
+    auto it = agg.groups.try_emplace(c.key).first;
+    apply_group(it->second, c, sign);
+    if(it->second.rows == 0) agg.groups.erase(it);
+}
+
+void result_group(sqlite3_context *ctx, const Aggregate &agg, const Group &group) {
+    if(!agg.sum) sqlite3_result_int64(ctx, group.rows);
+    else if(group.values == 0) sqlite3_result_null(ctx);    // like sum()
+    else if(group.real_values) sqlite3_result_double(ctx, group.int_sum + group.real_sum);
+    else sqlite3_result_int64(ctx, group.int_sum);
+}
+
+// Integral reals may come back as integers, so numbers compare by value
+bool same_value(sqlite3_value *a, sqlite3_value *b) {
+    int ta = sqlite3_value_type(a), tb = sqlite3_value_type(b);
+    bool a_num = ta == SQLITE_INTEGER || ta == SQLITE_FLOAT;
+    bool b_num = tb == SQLITE_INTEGER || tb == SQLITE_FLOAT;
+    if(a_num && b_num) {
+        if(ta == SQLITE_INTEGER && tb == SQLITE_INTEGER) return sqlite3_value_int64(a) == sqlite3_value_int64(b);
+        return sqlite3_value_double(a) == sqlite3_value_double(b);
+    }
+    if(ta != tb) return false;
+    if(ta == SQLITE_NULL) return true;
+    int n = sqlite3_value_bytes(a);
+    return n == sqlite3_value_bytes(b) && memcmp(sqlite3_value_blob(a), sqlite3_value_blob(b), n) == 0;
+}
+
+void preupdate(void *p, sqlite3 *db, int op, const char *db_name, const char *table, sqlite3_int64, sqlite3_int64) {
+    auto aggs = (Aggregates*) p;
+    // the database was replaced, everything is rebuilt on the next read
+    if(aggs->restores != snapshot_restores()) return;
+    if(strcmp(db_name, "main") != 0) return;
+
+    auto old_column = [&](int i) { sqlite3_value *v = nullptr; sqlite3_preupdate_old(db, i, &v); return v; };
+    auto new_column = [&](int i) { sqlite3_value *v = nullptr; sqlite3_preupdate_new(db, i, &v); return v; };
+
+    auto watched = std::ranges::find_if(aggs->tables, [&](auto &t) { return sqlite3_stricmp(t.table.c_str(), table) == 0; });
+    if(watched == aggs->tables.end()) return;
+    // most updates (movement, timers, ...) don't touch anything the aggregates read
+    if(op == SQLITE_UPDATE && std::ranges::all_of(watched->columns, [&](int i) { return same_value(old_column(i), new_column(i)); }))
+        return;
+
+    for(auto &agg : aggs->list) {
+        if(sqlite3_stricmp(agg->table.c_str(), table) != 0) continue;
+        Contribution before, after;
+        if(op != SQLITE_INSERT) before = contribution(*agg, old_column);
+        if(op != SQLITE_DELETE) after = contribution(*agg, new_column);
+        if(before == after) continue;
+        apply(*agg, before, -1);
+        apply(*agg, after, 1);
+    }
+}
+
+std::string table_query(const std::string &table) {
+    char *sql = sqlite3_mprintf("select * from \"%w\"", table.c_str());
+    std::string result = sql;
+    sqlite3_free(sql);
+    return result;
+}
+
+// Full scan, for new aggregates and after restore()
+bool rebuild(sqlite3 *db, Aggregate &agg) {
+    agg.total = {};
+    agg.groups.clear();
+    sqlite3_stmt *stmt;
+    if(sqlite3_prepare_v2(db, table_query(agg.table).c_str(), -1, &stmt, nullptr) != SQLITE_OK) return false;
+    auto column = [&](int i) { return sqlite3_column_value(stmt, i); };
+    while(sqlite3_step(stmt) == SQLITE_ROW) apply(agg, contribution(agg, column), 1);
+    return sqlite3_finalize(stmt) == SQLITE_OK;
+}
+
+bool refresh(sqlite3 *db, Aggregates &aggs) {
+    if(aggs.restores == snapshot_restores()) return true;
+    for(auto &agg : aggs.list)
+        if(!rebuild(db, *agg)) return false;
+    aggs.restores = snapshot_restores();
+    return true;
+}
+
+Aggregate *find_aggregate(Aggregates &aggs, std::string_view name) {
+    for(auto &agg : aggs.list)
+        if(agg->name == name) return agg.get();
+    return nullptr;
+}
+
+std::string_view trim(std::string_view s) {
+    while(!s.empty() && isspace((unsigned char) s.front())) s.remove_prefix(1);
+    while(!s.empty() && isspace((unsigned char) s.back())) s.remove_suffix(1);
+    return s;
+}
+
+bool iequals(std::string_view a, std::string_view b) {
+    return a.size() == b.size() && sqlite3_strnicmp(a.data(), b.data(), a.size()) == 0;
+}
+
+bool istarts_with(std::string_view s, std::string_view prefix) {
+    return s.size() >= prefix.size() && iequals(s.substr(0, prefix.size()), prefix);
+}
+
+bool iends_with(std::string_view s, std::string_view suffix) {
+    return s.size() >= suffix.size() && iequals(s.substr(s.size() - suffix.size()), suffix);
+}
+
+// Fills `agg` from the createAggregate() arguments, returns an error message or an empty string
+std::string parse_aggregate(sqlite3 *db, Aggregate &agg, std::string_view expr, std::string_view filter, std::string_view group) {
+    std::vector<std::string> columns, types;
+    sqlite3_stmt *stmt;
+    if(sqlite3_prepare_v2(db, table_query(agg.table).c_str(), -1, &stmt, nullptr) != SQLITE_OK) return sqlite3_errmsg(db);
+    for(int i = 0; i < sqlite3_column_count(stmt); ++i) {
+        columns.push_back(sqlite3_column_name(stmt, i));
+        auto type = sqlite3_column_decltype(stmt, i);
+        types.push_back(type ? type : "");
+    }
+    sqlite3_finalize(stmt);
+
+    auto find_column = [&](std::string_view name) {
+        name = trim(name);
+        for(size_t i = 0; i < columns.size(); ++i)
+            if(iequals(columns[i], name)) return (int) i;
+        return -1;
+    };
+
+    expr = trim(expr);
+    if(iequals(expr, "count(*)")) {
+        agg.sum = false;
+    } else if(istarts_with(expr, "sum(") && expr.ends_with(")")) {
+        agg.sum = true;
+        agg.value_column = find_column(expr.substr(4, expr.size() - 5));
+        if(agg.value_column < 0) return "unknown column in " + std::string(expr);
+        // SQLite's affinity rules, the integer ones come first
+        std::string_view type = types[agg.value_column];
+        auto has = [&](std::string_view word) {
+            for(size_t i = 0; i + word.size() <= type.size(); ++i)
+                if(iequals(type.substr(i, word.size()), word)) return true;
+            return false;
+        };
+        agg.real_column = !has("int") && !has("char") && !has("clob") && !has("text") && !has("blob") && !type.empty()
+            && (has("real") || has("floa") || has("doub"));
+    } else {
+        return "expected count(*) or sum(column), got " + std::string(expr);
+    }
+
+    while(!trim(filter).empty()) {
+        std::string_view term = filter;
+        size_t and_pos = std::string_view::npos;
+        for(size_t i = 0; i + 5 <= filter.size(); ++i) {
+            if(iequals(filter.substr(i, 5), " and ")) {
+                and_pos = i;
+                break;
+            }
+        }
+        if(and_pos != std::string_view::npos) {
+            term = filter.substr(0, and_pos);
+            filter.remove_prefix(and_pos + 5);
+        } else {
+            filter = {};
+        }
+        term = trim(term);
+
+        Term t{-1, TERM_TRUE, 0};
+        std::string_view column = term;
+        if(istarts_with(term, "not ")) {
+            t.kind = TERM_FALSE;
+            column = term.substr(4);
+        } else if(iends_with(term, " is not null")) {
+            t.kind = TERM_NOT_NULL;
+            column = term.substr(0, term.size() - 12);
+        } else if(size_t eq = term.find('='); eq != std::string_view::npos) {
+            t.kind = TERM_EQUALS;
+            column = term.substr(0, eq);
+            std::string number(trim(term.substr(eq + 1)));
+            char *end;
+            t.value = strtod(number.c_str(), &end);
+            if(number.empty() || *end) return "expected a number in " + std::string(term);
+        }
+        t.column = find_column(column);
+        if(t.column < 0) return "unknown column in " + std::string(term);
+        agg.filter.push_back(t);
+    }
+
+    if(!trim(group).empty()) {
+        agg.group_column = find_column(group);
+        if(agg.group_column < 0) return "unknown group column " + std::string(group);
+    }
+    return {};
+}
+
+std::string_view text_arg(sqlite3_value *v) {
+    if(sqlite3_value_type(v) == SQLITE_NULL) return {};
+    return {(const char*) sqlite3_value_text(v), (size_t) sqlite3_value_bytes(v)};
+}
+
+void sql_createAggregate(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
+    assert(argc >= 3 && argc <= 5);
+    auto &aggs = *(Aggregates*) sqlite3_user_data(ctx);
+    sqlite3 *db = sqlite3_context_db_handle(ctx);
+
+    std::string definition;
+    for(int i = 1; i < argc; ++i) {
+        definition += text_arg(argv[i]);
+        definition += '\0';
+    }
+    auto name = text_arg(argv[0]);
+    if(auto existing = find_aggregate(aggs, name)) {
+        if(existing->definition != definition)
+            sqlite3_result_error(ctx, "createAggregate(): an aggregate with this name already exists", -1);
+        return;
+    }
+
+    auto agg = std::make_unique<Aggregate>();
+    agg->name = name;
+    agg->table = text_arg(argv[1]);
+    agg->definition = definition;
+    auto err = parse_aggregate(db, *agg, text_arg(argv[2]),
+        argc > 3 ? text_arg(argv[3]) : std::string_view(),
+        argc > 4 ? text_arg(argv[4]) : std::string_view());
+    if(err.empty() && (!refresh(db, aggs) || !rebuild(db, *agg))) err = sqlite3_errmsg(db);
+    if(!err.empty()) {
+        err = "createAggregate(): " + err;
+        sqlite3_result_error(ctx, err.c_str(), -1);
+        return;
+    }
+    auto watched = std::ranges::find_if(aggs.tables, [&](auto &t) { return sqlite3_stricmp(t.table.c_str(), agg->table.c_str()) == 0; });
+    if(watched == aggs.tables.end()) watched = aggs.tables.insert(watched, {agg->table, {}});
+    auto watch = [&](int column) {
+        if(column >= 0 && std::ranges::find(watched->columns, column) == watched->columns.end()) watched->columns.push_back(column);
+    };
+    watch(agg->value_column);
+    watch(agg->group_column);
+    for(auto &term : agg->filter) watch(term.column);
+    aggs.list.push_back(std::move(agg));
+
+    if(!aggs.hooked) {
+        sqlite3_preupdate_hook(db, preupdate, &aggs);
+        aggs.hooked = true;
+    }
+}
+
+void sql_aggregate(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
+    assert(argc == 1 || argc == 2);
+    auto &aggs = *(Aggregates*) sqlite3_user_data(ctx);
+    auto agg = find_aggregate(aggs, text_arg(argv[0]));
+    if(!agg) {
+        sqlite3_result_error(ctx, "aggregate(): no such aggregate", -1);
+        return;
+    }
+    if(!refresh(sqlite3_context_db_handle(ctx), aggs)) {
+        sqlite3_result_error(ctx, "aggregate(): failed to rebuild after restore()", -1);
+        return;
+    }
+    if(argc == 1) {
+        result_group(ctx, *agg, agg->total);
+        return;
+    }
+    if(agg->group_column < 0) {
+        sqlite3_result_error(ctx, "aggregate(): the aggregate has no groups", -1);
+        return;
+    }
+    auto it = agg->groups.find(make_key(argv[1]));
+    result_group(ctx, *agg, it != agg->groups.end() ? it->second : Group{});
+}
+
+struct GroupsTable {
+    sqlite3_vtab base;
+    sqlite3 *db;
+    Aggregates *aggs;
+};
+
+struct GroupsCursor {
+    sqlite3_vtab_cursor base;
+    // copied, so statements changing the table while it's scanned can't invalidate it
+    std::vector<std::pair<const Aggregate*, std::pair<Key, Group>>> rows;
+    size_t row;
+};
+
+int groups_connect(sqlite3 *db, void *aux, int argc, const char *const *argv, sqlite3_vtab **vtab, char **err) {
+    int rc = sqlite3_declare_vtab(db, "create table x(name text, key, value)");
+    if(rc != SQLITE_OK) return rc;
+    auto table = new GroupsTable();
+    table->db = db;
+    table->aggs = (Aggregates*) aux;
+    *vtab = &table->base;
+    return SQLITE_OK;
+}
+
+int groups_disconnect(sqlite3_vtab *vtab) {
+    delete (GroupsTable*) vtab;
+    return SQLITE_OK;
+}
+
+int groups_best_index(sqlite3_vtab *vtab, sqlite3_index_info *info) {
+    info->idxNum = 0;
+    info->estimatedCost = 100;
+    for(int i = 0; i < info->nConstraint; ++i) {
+        auto &c = info->aConstraint[i];
+        if(c.usable && c.iColumn == 0 && c.op == SQLITE_INDEX_CONSTRAINT_EQ) {
+            info->idxNum = 1;
+            info->aConstraintUsage[i].argvIndex = 1;
+            info->aConstraintUsage[i].omit = 1;
+            info->estimatedCost = 10;
+            break;
+        }
+    }
+    return SQLITE_OK;
+}
+
+int groups_open(sqlite3_vtab *vtab, sqlite3_vtab_cursor **cursor) {
+    auto cur = new GroupsCursor();
+    *cursor = &cur->base;
+    return SQLITE_OK;
+}
+
+int groups_close(sqlite3_vtab_cursor *cursor) {
+    delete (GroupsCursor*) cursor;
+    return SQLITE_OK;
+}
+
+int groups_filter(sqlite3_vtab_cursor *cursor, int idxNum, const char *idxStr, int argc, sqlite3_value **argv) {
+    auto cur = (GroupsCursor*) cursor;
+    auto table = (GroupsTable*) cursor->pVtab;
+    cur->rows.clear();
+    cur->row = 0;
+    if(!refresh(table->db, *table->aggs)) return SQLITE_ERROR;
+    for(auto &agg : table->aggs->list) {
+        if(idxNum == 1 && agg->name != text_arg(argv[0])) continue;
+        for(auto &group : agg->groups) cur->rows.push_back({agg.get(), group});
+    }
+    return SQLITE_OK;
+}
+
+int groups_next(sqlite3_vtab_cursor *cursor) {
+    ((GroupsCursor*) cursor)->row++;
+    return SQLITE_OK;
+}
+
+int groups_eof(sqlite3_vtab_cursor *cursor) {
+    auto cur = (GroupsCursor*) cursor;
+    return cur->row >= cur->rows.size();
+}
+
+int groups_column(sqlite3_vtab_cursor *cursor, sqlite3_context *ctx, int col) {
+    auto cur = (GroupsCursor*) cursor;
+    auto &[agg, group] = cur->rows[cur->row];
+    switch(col) {
+        case 0: sqlite3_result_text(ctx, agg->name.c_str(), -1, SQLITE_STATIC); break;
+        case 1: result_key(ctx, group.first); break;
+        case 2: result_group(ctx, *agg, group.second); break;
+    }
+    return SQLITE_OK;
+}
+
+int groups_rowid(sqlite3_vtab_cursor *cursor, sqlite3_int64 *rowid) {
+    *rowid = ((GroupsCursor*) cursor)->row + 1;
+    return SQLITE_OK;
+}
+
+sqlite3_module groups_module = {
+    .iVersion = 0,
+    .xConnect = groups_connect,
+    .xBestIndex = groups_best_index,
+    .xDisconnect = groups_disconnect,
+    .xOpen = groups_open,
+    .xClose = groups_close,
+    .xFilter = groups_filter,
+    .xNext = groups_next,
+    .xEof = groups_eof,
+    .xColumn = groups_column,
+    .xRowid = groups_rowid,
+};
+
+void create_aggregate_functions(sqlite3 *db) {
+    auto aggs = new Aggregates();
+    aggs->restores = snapshot_restores();
+    int rc = sqlite3_create_module_v2(db, "aggregate_groups", &groups_module, aggs, [](void *p) { delete (Aggregates*) p; });
+    if(rc != SQLITE_OK) throw std::runtime_error("failed to create virtual table module");
+    for(int argc = 3; argc <= 5 && rc == SQLITE_OK; ++argc)
+        rc = sqlite3_create_function(db, "createAggregate", argc, SQLITE_UTF8, aggs, sql_createAggregate, nullptr, nullptr);
+    if(rc == SQLITE_OK) rc = sqlite3_create_function(db, "aggregate", 1, SQLITE_UTF8, aggs, sql_aggregate, nullptr, nullptr);
+    if(rc == SQLITE_OK) rc = sqlite3_create_function(db, "aggregate", 2, SQLITE_UTF8, aggs, sql_aggregate, nullptr, nullptr);
+    if(rc != SQLITE_OK) throw std::runtime_error("failed to create function");
+}
+
+}
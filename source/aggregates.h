@@ -0,0 +1,21 @@
+#pragma once
+
+struct sqlite3;
+
+namespace sqhell {
+
+// Registers counters over a table that are kept up to date as rows change,
+// so reading them doesn't scan the table:
+//   createAggregate(name, table, 'count(*)' | 'sum(column)' [, filter [, group_column]])
+//   aggregate(name [, group]) - current value, over all groups without one
+//   aggregate_groups(name, key, value) - eponymous table of the groups, in key order
+// The filter is a list of terms joined by `and`, each one `column`, `not column`,
+// `column is not null` or `column = number`. createAggregate() does nothing when the
+// aggregate already exists with the same definition, so scripts can call it every frame.
+//
+// Changes come from the preupdate hook, which needs SQLITE_ENABLE_PREUPDATE_HOOK. Changes to
+// virtual tables and rolled back statements aren't seen; after restore() every aggregate is
+// rebuilt with a full scan.
+void create_aggregate_functions(sqlite3 *db);
+
+}
@@ -0,0 +1,85 @@
+#include <archive.h>
+#include <string_view>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace sqhell {
+
+const char *archive_base = nullptr;
+const ArchiveEntry *archive_entries = nullptr;
+uint32_t archive_count = 0;
+
+bool in_file(uint64_t offset, uint64_t length, size_t file_size) {
+    return offset <= file_size && length <= file_size - offset;
+}
+
+// Lookups trust the entries, so they're checked once here: every path and file lies inside
+// the archive, every file is followed by its '\0', and the paths are sorted and unique
+bool valid_entries(const char *base, size_t file_size, const ArchiveEntry *entries, uint32_t count) {
+    std::string_view prev;
+    for(uint32_t i = 0; i < count; ++i) {
+        auto &e = entries[i];
+        if(!in_file(e.path_offset, e.path_size, file_size) || !in_file(e.data_offset, e.data_size, file_size - 1) ||
+            base[e.data_offset + e.data_size] != '\0') return false;
+        std::string_view path(base + e.path_offset, e.path_size);
+        if(i > 0 && path <= prev) return false;
+        prev = path;
+    }
+    return true;
+}
+
+bool mount_archive(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) return false;
+    struct stat st;
+    if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ArchiveHeader)) {
+        close(fd);
+        return false;
+    }
+    void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(addr == MAP_FAILED) return false;
+
+    auto header = (const ArchiveHeader*) addr;
+    auto entries = (const ArchiveEntry*) ((const char*) addr + sizeof(ArchiveHeader));
+    if(memcmp(header->magic, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC)) != 0
+    || sizeof(ArchiveHeader) + (size_t) header->count * sizeof(ArchiveEntry) > (size_t)st.st_size
+    || !valid_entries((const char*) addr, st.st_size, entries, header->count)) {
+        fprintf(stderr, "%s is not a valid asset archive\n", path);
+        munmap(addr, st.st_size);
+        return false;
+    }
+
+    archive_base = (const char*) addr;
+    archive_entries = entries;
+    archive_count = header->count;
+    return true;
+}
+
+std::string_view entry_path(const ArchiveEntry &entry) {
+    return {archive_base + entry.path_offset, entry.path_size};
+}
+
+bool archive_lookup(const char *path, const char *&data, size_t &size) {
+    if(!archive_base) return false;
+
+    std::string_view key(path);
+    while(key.starts_with("./")) key.remove_prefix(2);
+
+    auto end = archive_entries + archive_count;
+    auto it = std::lower_bound(archive_entries, end, key, [](const ArchiveEntry &e, std::string_view k) {
+        return entry_path(e) < k;
+    });
+    if(it == end || entry_path(*it) != key) return false;
+
+    data = archive_base + it->data_offset;
+    size = it->data_size;
+    return true;
+}
+
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace sqhell {
+
+// Asset archive layout, written by tools/sqhell_pack.cpp:
+//   ArchiveHeader
+//   ArchiveEntry[count], sorted by path
+//   path strings and file contents, each file followed by a '\0'
+// All offsets are relative to the start of the file.
+
+constexpr char ARCHIVE_MAGIC[8] = {'S','Q','H','P','A','K','1','\0'};
+
+struct ArchiveHeader {
+    char magic[8];
+    uint32_t count;
+    uint32_t reserved;
+};
+
+struct ArchiveEntry {
+    uint64_t path_offset;
+    uint64_t data_offset;
+    uint64_t data_size;
+    uint32_t path_size;
+    uint32_t reserved;
+};
+
+// Maps the archive into memory. Returns false if it can't be opened or isn't an archive.
+bool mount_archive(const char *path);
+
+// Looks up a file inside the mounted archive.
+// The data lives until the end of the program and is followed by a '\0'.
+bool archive_lookup(const char *path, const char *&data, size_t &size);
+
+}
@@ -0,0 +1,42 @@
+#include <arena.h>
+#include <frame.h>
+#include <algorithm>
+#include <cstring>
+
+namespace sqhell {
+
+constexpr size_t ARENA_BLOCK_SIZE = 64 << 10;
+
+void *FrameArena::alloc(size_t size) {
+    size = (size + 15) & ~size_t(15);
+    if(frame != current_frame()) {
+        frame = current_frame();
+        used = 0;
+        // last frame needed more than one block, replace them with one that fits it all
+        if(blocks.size() > 1) {
+            blocks.clear();
+            block_sizes.clear();
+            blocks.emplace_back(new char[total]);
+            block_sizes.push_back(total);
+        }
+    }
+    if(blocks.empty() || used + size > block_sizes.back()) {
+        size_t block_size = std::max({size, ARENA_BLOCK_SIZE, total});
+        blocks.emplace_back(new char[block_size]);
+        block_sizes.push_back(block_size);
+        total += block_size;
+        used = 0;
+    }
+    void *ptr = blocks.back().get() + used;
+    used += size;
+    return ptr;
+}
+
+char *FrameArena::copy(const char *str, size_t size) {
+    auto dst = (char*) alloc(size + 1);
+    memcpy(dst, str, size);
+    dst[size] = '\0';
+    return dst;
+}
+
+}
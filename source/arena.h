@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace sqhell {
+
+// Bump allocator for scratch memory that only has to live until the end of the frame.
+// Everything is released at once the first time it's used in a new frame. The blocks
+// are kept, so once the arena has grown to a frame's peak use it stops allocating.
+class FrameArena {
+public:
+    void *alloc(size_t size);
+    // Copies the string and NUL terminates it
+    char *copy(const char *str, size_t size);
+
+private:
+    std::vector<std::unique_ptr<char[]>> blocks;
+    std::vector<size_t> block_sizes;
+    size_t used = 0;        // in the last block
+    size_t total = 0;       // capacity of all blocks
+    uint64_t frame = UINT64_MAX;
+};
+
+}
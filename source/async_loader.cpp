@@ -0,0 +1,251 @@
+#include <async_loader.h>
+#include <archive.h>
+#include <vtab.h>
+#include <sqlite3.h>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef SQHELL_HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+namespace sqhell {
+
+struct AsyncLoad;
+
+// Loads finished by either backend, waiting for the next collect_async_loads()
+// on the thread that started them
+struct LoadQueue {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<AsyncLoad>> finished;
+};
+
+struct AsyncLoad {
+    std::shared_ptr<LoadQueue> owner;
+    int64_t id;
+    std::string path;
+    std::string data;
+    std::string_view bytes; // data, or the file's contents inside the archive
+    std::string error;
+    int fd = -1;
+    size_t done = 0;
+};
+
+using LoadPtr = std::unique_ptr<AsyncLoad>;
+
+// Per thread, so every world running a script sees only its own loads
+thread_local int64_t next_load_id = 1;
+thread_local std::vector<LoadPtr> completed_loads; // visible in the completed_loads table this frame
+thread_local auto load_queue = std::make_shared<LoadQueue>();
+
+void finish(LoadPtr load, const char *error) {
+    if(error) {
+        load->error = error;
+        load->data.clear();
+    }
+    if(load->bytes.empty()) load->bytes = load->data;
+    if(load->fd >= 0) close(load->fd);
+    load->fd = -1;
+    auto owner = load->owner;
+    std::lock_guard lock(owner->mutex);
+    owner->finished.push_back(std::move(load));
+}
+
+// Thread pool backend
+
+struct ThreadPool {
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<LoadPtr> queue;
+    std::vector<std::thread> workers;
+    bool stopping = false;
+
+    ~ThreadPool() {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        cv.notify_all();
+        for(auto &w : workers) w.join();
+    }
+};
+
+ThreadPool pool;
+
+void pool_worker() {
+    while(true) {
+        LoadPtr load;
+        {
+            std::unique_lock lock(pool.mutex);
+            pool.cv.wait(lock, []{ return pool.stopping || !pool.queue.empty(); });
+            if(pool.stopping) return;
+            load = std::move(pool.queue.front());
+            pool.queue.pop_front();
+        }
+        const char *error = nullptr;
+        while(load->done < load->data.size()) {
+            ssize_t n = pread(load->fd, load->data.data() + load->done, load->data.size() - load->done, load->done);
+            if(n < 0 && errno == EINTR) continue;
+            if(n <= 0) {
+                error = n < 0 ? strerror(errno) : "file truncated while reading";
+                break;
+            }
+            load->done += n;
+        }
+        finish(std::move(load), error);
+    }
+}
+
+void pool_submit(LoadPtr load) {
+    {
+        std::lock_guard lock(pool.mutex);
+        if(pool.workers.empty()) {
+            unsigned n = std::clamp(std::thread::hardware_concurrency(), 1u, 4u);
+            for(unsigned i = 0; i < n; ++i) pool.workers.emplace_back(pool_worker);
+        }
+        pool.queue.push_back(std::move(load));
+    }
+    pool.cv.notify_one();
+}
+
+// io_uring backend, one ring per thread running a script
+
+#ifdef SQHELL_HAVE_LIBURING
+struct Uring {
+    io_uring ring;
+    bool initialized = false;
+    bool available = false;
+    unsigned unsubmitted = 0;
+
+    bool init() {
+        if(!initialized) {
+            initialized = true;
+            available = io_uring_queue_init(64, &ring, 0) == 0;
+        }
+        return available;
+    }
+    ~Uring() { if(available) io_uring_queue_exit(&ring); }
+};
+
+thread_local Uring uring;
+
+void uring_queue_read(AsyncLoad *load) {
+    io_uring_sqe *sqe = io_uring_get_sqe(&uring.ring);
+    if(!sqe) {
+        io_uring_submit(&uring.ring);
+        uring.unsubmitted = 0;
+        sqe = io_uring_get_sqe(&uring.ring);
+    }
+    io_uring_prep_read(sqe, load->fd, load->data.data() + load->done, load->data.size() - load->done, load->done);
+    io_uring_sqe_set_data(sqe, load);
+    ++uring.unsubmitted;
+}
+
+// Submits reads queued during the frame in one syscall and handles completed ones
+void uring_poll() {
+    if(!uring.available) return;
+    if(uring.unsubmitted) {
+        io_uring_submit(&uring.ring);
+        uring.unsubmitted = 0;
+    }
+    io_uring_cqe *cqe;
+    while(io_uring_peek_cqe(&uring.ring, &cqe) == 0) {
+        LoadPtr load((AsyncLoad*) io_uring_cqe_get_data(cqe));
+        int res = cqe->res;
+        io_uring_cqe_seen(&uring.ring, cqe);
+
+        if(res < 0) finish(std::move(load), strerror(-res));
+        else if(res == 0) finish(std::move(load), "file truncated while reading");
+        else if((load->done += res) < load->data.size()) uring_queue_read(load.release());
+        else finish(std::move(load), nullptr);
+    }
+}
+#endif
+
+int64_t load_async(const char *path) {
+    auto load = std::make_unique<AsyncLoad>();
+    load->owner = load_queue;
+    load->id = next_load_id++;
+    load->path = path;
+    int64_t id = load->id;
+
+    const char *data;
+    size_t size;
+    if(archive_lookup(path, data, size)) {
+        load->bytes = {data, size};
+        finish(std::move(load), nullptr);
+        return id;
+    }
+
+    load->fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if(load->fd < 0 || fstat(load->fd, &st) != 0) {
+        finish(std::move(load), strerror(errno));
+        return id;
+    }
+    load->data.resize(st.st_size);
+    if(load->data.empty()) {
+        finish(std::move(load), nullptr);
+        return id;
+    }
+
+#ifdef SQHELL_HAVE_LIBURING
+    if(uring.init()) {
+        uring_queue_read(load.release());
+        return id;
+    }
+#endif
+    pool_submit(std::move(load));
+    return id;
+}
+
+void collect_async_loads() {
+#ifdef SQHELL_HAVE_LIBURING
+    uring_poll();
+#endif
+    completed_loads.clear();
+    std::lock_guard lock(load_queue->mutex);
+    std::swap(completed_loads, load_queue->finished);
+}
+
+// completed_loads virtual table
+
+struct CompletedLoadsTable {
+    static constexpr const char *schema = "create table x(id integer, path text, data blob, error text)";
+
+    static size_t row_count() { return completed_loads.size(); }
+
+    // Loads stay alive until the next collect_async_loads(), so data doesn't need to be copied
+    static void column(size_t row, sqlite3_context *ctx, int col) {
+        auto &load = *completed_loads[row];
+        switch(col) {
+            case 0: sqlite3_result_int64(ctx, load.id); break;
+            case 1: sqlite3_result_text(ctx, load.path.c_str(), load.path.size(), SQLITE_STATIC); break;
+            case 2:
+                if(load.error.empty()) sqlite3_result_blob(ctx, load.bytes.data(), load.bytes.size(), SQLITE_STATIC);
+                else sqlite3_result_null(ctx);
+                break;
+            case 3:
+                if(load.error.empty()) sqlite3_result_null(ctx);
+                else sqlite3_result_text(ctx, load.error.c_str(), load.error.size(), SQLITE_STATIC);
+                break;
+        }
+    }
+};
+
+void create_completed_loads_module(sqlite3 *db) {
+    create_eponymous_table<CompletedLoadsTable>(db, "completed_loads");
+}
+
+}
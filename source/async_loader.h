@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+
+struct sqlite3;
+
+namespace sqhell {
+
+// Starts reading the whole file in the background and returns the request id.
+// Reads go through io_uring when available, otherwise through a small thread pool.
+int64_t load_async(const char *path);
+
+// Publishes loads this thread started that finished since the previous call in the completed_loads table
+// and frees the ones published before. Call once per frame, between statements.
+void collect_async_loads();
+
+// Registers the eponymous completed_loads(id, path, data, error) virtual table
+void create_completed_loads_module(sqlite3 *db);
+
+}
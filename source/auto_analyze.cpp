@@ -0,0 +1,153 @@
+#include <auto_analyze.h>
+#include <script.h>
+#include <query_plans.h>
+#include <logger.h>
+#include <sqlite3.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace sqhell {
+
+// A table has to change size by this factor, and end up or start with at least
+// MIN_ROWS rows, before its statistics are worth refreshing. Plans that cost
+// more after an ANALYZE are only reverted past REGRESSION_STEPS.
+constexpr int64_t GROWTH_FACTOR = 4;
+constexpr int64_t MIN_ROWS = 1000;
+constexpr double REGRESSION_STEPS = 1000;
+
+// Rows ANALYZE samples per index, so it takes about the same time however big the tables get
+constexpr const char *ANALYZE_SQL = "pragma analysis_limit = 1000; analyze;";
+
+std::unordered_map<std::string, int64_t> count_rows(sqlite3 *db) {
+    std::unordered_map<std::string, int64_t> rows;
+    std::vector<std::string> tables;
+    sqlite3_stmt *stmt;
+    if(sqlite3_prepare_v2(db, "select name from sqlite_schema where type = 'table' and name not like 'sqlite\\_%' escape '\\'",
+        -1, &stmt, nullptr) != SQLITE_OK) return rows;
+    while(sqlite3_step(stmt) == SQLITE_ROW) tables.emplace_back((const char*) sqlite3_column_text(stmt, 0));
+    sqlite3_finalize(stmt);
+
+    for(auto &table : tables) {
+        std::string quoted = "\"";
+        for(char c : table) quoted += c == '"' ? "\"\"" : std::string(1, c);
+        auto sql = "select count(*) from " + quoted + "\"";
+        if(sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) continue;
+        if(sqlite3_step(stmt) == SQLITE_ROW) rows[table] = sqlite3_column_int64(stmt, 0);
+        sqlite3_finalize(stmt);
+    }
+    return rows;
+}
+
+int collect_table(void *tables, int action, const char *arg1, const char*, const char*, const char*) {
+    bool uses_table = action == SQLITE_READ || action == SQLITE_UPDATE || action == SQLITE_INSERT || action == SQLITE_DELETE;
+    auto &found = *(std::vector<std::string>*) tables;
+    if(uses_table && arg1 && std::ranges::find(found, arg1) == found.end()) found.emplace_back(arg1);
+    return SQLITE_OK;
+}
+
+// Tables the statement reads or writes, as the authorizer sees them while it's prepared again
+std::vector<std::string> statement_tables(sqlite3 *db, sqlite3_stmt *stmt) {
+    std::vector<std::string> tables;
+    sqlite3_set_authorizer(db, collect_table, &tables);
+    sqlite3_stmt *copy;
+    if(sqlite3_prepare_v2(db, sqlite3_sql(stmt), -1, &copy, nullptr) == SQLITE_OK) sqlite3_finalize(copy);
+    sqlite3_set_authorizer(db, nullptr, nullptr);
+    return tables;
+}
+
+// Deletes the statistics of the tables and reloads the rest, so the planner goes back to its
+// defaults for them. ANALYZE expired every statement, so they're prepared again when they next run.
+void drop_statistics(sqlite3 *db, const std::vector<std::string> &tables) {
+    sqlite3_stmt *stmt;
+    if(sqlite3_prepare_v2(db, "delete from sqlite_stat1 where tbl = ?", -1, &stmt, nullptr) != SQLITE_OK) return;
+    for(auto &table : tables) {
+        sqlite3_bind_text(stmt, 1, table.c_str(), -1, SQLITE_STATIC);
+        sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_exec(db, "analyze sqlite_schema", nullptr, nullptr, nullptr);
+}
+
+// Negative when the statement didn't run
+double steps_per_run(sqlite3_stmt *stmt, bool reset) {
+    int runs = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_RUN, reset);
+    int steps = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_VM_STEP, reset);
+    return runs ? (double) steps / runs : -1;
+}
+
+void report_costs(sqlite3 *db, AutoAnalyze &state) {
+    std::vector<std::string> regressed;
+    for(auto &change : state.changes) {
+        double after = steps_per_run(change.stmt, false);
+        if(change.steps_before < 0 || after < 0) {
+            log_message(LOG_INFO, "Statement at line %d: no cost to compare, it didn't run with %s plan",
+                change.line, after < 0 ? "the new" : "the old");
+            continue;
+        }
+        bool slower = after > change.steps_before * 1.25 && after - change.steps_before > REGRESSION_STEPS;
+        log_message(slower ? LOG_WARN : LOG_INFO,
+            "Statement at line %d: %.0f VM steps per run with the old plan, %.0f with the new one%s",
+            change.line, change.steps_before, after, slower ? ", dropping the statistics of its tables" : "");
+        if(!slower) continue;
+        for(auto &table : change.tables)
+            if(std::ranges::find(regressed, table) == regressed.end()) regressed.push_back(table);
+    }
+    state.changes.clear();
+    if(!regressed.empty()) drop_statistics(db, regressed);
+}
+
+void analyze(sqlite3 *db, Script &script, AutoAnalyze &state, const std::string &reason) {
+    // costs still waiting for their report refer to statements that may be prepared again
+    report_costs(db, state);
+
+    std::vector<std::string> before(script.statements.size());
+    for(size_t i = 0; i < script.statements.size(); ++i)
+        if(script.statements[i].stmt) before[i] = query_plan(db, script.statements[i].stmt);
+
+    auto start = std::chrono::steady_clock::now();
+    char *err = nullptr;
+    if(sqlite3_exec(db, ANALYZE_SQL, nullptr, nullptr, &err) != SQLITE_OK) {
+        log_message(LOG_WARN, "ANALYZE failed: %s", err);
+        sqlite3_free(err);
+        return;
+    }
+    log_message(LOG_INFO, "ANALYZE (%s) took %.1f ms", reason.c_str(),
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    state.rows = count_rows(db);
+
+    for(size_t i = 0; i < script.statements.size(); ++i) {
+        auto &s = script.statements[i];
+        if(!s.stmt) continue;
+        // ANALYZE expired the statement, so it picks up the new plan the next time it runs.
+        // Its counters restart with it, for the cost comparison.
+        auto after = query_plan(db, s.stmt);
+        double steps_before = steps_per_run(s.stmt, true);
+        if(after == before[i]) continue;
+        log_message(LOG_INFO, "Query plan of the statement at line %d changed from\n%s  to\n%.*s", s.line,
+            before[i].c_str(), (int) after.size() - 1, after.c_str());
+        state.changes.push_back({s.stmt, s.line, steps_before, statement_tables(db, s.stmt)});
+    }
+    state.report_frame = state.frames + state.interval;
+}
+
+void auto_analyze_end_frame(sqlite3 *db, Script &script, AutoAnalyze &state) {
+    if(state.interval <= 0) return;
+    ++state.frames;
+    if(!state.changes.empty() && state.frames >= state.report_frame) report_costs(db, state);
+
+    if(state.frames % state.interval) return;
+
+    for(auto &[table, rows] : count_rows(db)) {
+        auto found = state.rows.find(table);
+        int64_t old_rows = found != state.rows.end() ? found->second : 0;
+        int64_t larger = std::max(rows, old_rows), smaller = std::min(rows, old_rows);
+        if(larger < MIN_ROWS || larger < GROWTH_FACTOR * std::max<int64_t>(smaller, 1)) continue;
+        analyze(db, script, state, table + " went from " + std::to_string(old_rows) + " to " + std::to_string(rows) + " rows");
+        return;
+    }
+}
+
+}
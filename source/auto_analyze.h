@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+namespace sqhell {
+
+struct Script;
+
+struct PlanChange {
+    sqlite3_stmt *stmt;
+    int line;
+    double steps_before;    // VM steps per run with the old plan, negative if it never ran
+    std::vector<std::string> tables;    // it reads or writes
+};
+
+struct AutoAnalyze {
+    int interval = 0;       // frames between row count checks, 0 disables them
+    uint64_t frames = 0;
+    uint64_t report_frame = 0;  // when the costs of the changed plans are logged
+    std::unordered_map<std::string, int64_t> rows;  // per table, as of the last ANALYZE
+    std::vector<PlanChange> changes;                // waiting for `interval` frames with the new plan
+};
+
+// The script is prepared against empty tables, so the planner has no statistics for the tables
+// it ends up running on. Every `interval` frames this counts the rows of each table, and runs
+// ANALYZE when one of them grew or shrank by a factor of 4 since the last ANALYZE (or since it
+// was empty) and has at least 1000 rows on one side. The old and new plans of the statements whose
+// plan changed are logged, followed by their cost in VM steps per run once the new plan has run for
+// `interval` frames. When a new plan costs clearly more, the statistics of the statement's tables
+// are dropped again, until the next ANALYZE.
+// Call between two passes over the script, when no statement is running.
+void auto_analyze_end_frame(sqlite3 *db, Script &script, AutoAnalyze &state);
+
+}
@@ -0,0 +1,141 @@
+#include <entity_pool.h>
+#include <frame.h>
+#include <snapshot.h>
+#include <sqlite3.h>
+#include <deque>
+#include <memory_resource>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+#include <cassert>
+#include <algorithm>
+#include <cstdint>
+
+namespace sqhell {
+
+// Ids handed out in earlier frames are checked once this many pile up, or when the free list runs out
+constexpr size_t RECLAIM_BATCH = 4096;
+
+struct Pool {
+    explicit Pool(std::string_view table) : table(table) {}
+
+    std::string table;
+    std::vector<int64_t> free;      // popped from the back
+    std::pmr::unsynchronized_pool_resource nodes;   // recycles the set's nodes, despawn() doesn't allocate once warm
+    std::pmr::unordered_set<int64_t> is_free{&nodes};  // so an id can't be handed out twice
+    std::vector<int64_t> spawned;   // handed out and not checked yet, the first `settled` of them in earlier frames
+    size_t settled = 0;
+    uint64_t spawn_frame = 0;
+    uint64_t restores = UINT64_MAX; // snapshot_restores() when the free list was filled
+};
+
+// One set of pools per connection, few enough to search linearly. A deque keeps them in place.
+struct Pools {
+    std::deque<Pool> pools;
+};
+
+Pool &find_pool(sqlite3_context *ctx, std::string_view table) {
+    auto &pools = ((Pools*) sqlite3_user_data(ctx))->pools;
+    for(auto &pool : pools)
+        if(pool.table == table) return pool;
+    return pools.emplace_back(table);
+}
+
+bool push_free(Pool &pool, int64_t id) {
+    if(id < 0) return false;
+    if(pool.is_free.insert(id).second) pool.free.push_back(id);
+    return true;
+}
+
+std::string pool_error(sqlite3 *db) {
+    return "entity pool: " + std::string(sqlite3_errmsg(db));
+}
+
+// (Re)fills the free list from the dead rows, lowest id first out
+bool fill_pool(sqlite3_context *ctx, Pool &pool) {
+    if(pool.restores == snapshot_restores()) return true;
+    pool.free.clear();
+    pool.is_free.clear();
+    pool.spawned.clear();
+    pool.settled = 0;
+
+    sqlite3 *db = sqlite3_context_db_handle(ctx);
+    char *sql = sqlite3_mprintf("select rowid from \"%w\" where not alive order by rowid desc", pool.table.c_str());
+    sqlite3_stmt *stmt;
+    int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr);
+    sqlite3_free(sql);
+    if(rc != SQLITE_OK) {
+        sqlite3_result_error(ctx, pool_error(db).c_str(), -1);
+        return false;
+    }
+    while(sqlite3_step(stmt) == SQLITE_ROW) push_free(pool, sqlite3_column_int64(stmt, 0));
+    sqlite3_finalize(stmt);
+    pool.restores = snapshot_restores();
+    return true;
+}
+
+// An id spawn() handed out is only used once the insert runs, which can be after every spawn() of the
+// statement. So ids from earlier frames whose rows are still dead were never used, the insert failed
+// or didn't take them, and go back to the free list.
+bool reclaim_unused(sqlite3_context *ctx, Pool &pool) {
+    if(!pool.settled) return true;
+    sqlite3 *db = sqlite3_context_db_handle(ctx);
+    char *sql = sqlite3_mprintf("select not alive from \"%w\" where rowid = ?", pool.table.c_str());
+    sqlite3_stmt *stmt;
+    int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr);
+    sqlite3_free(sql);
+    if(rc != SQLITE_OK) {
+        sqlite3_result_error(ctx, pool_error(db).c_str(), -1);
+        return false;
+    }
+    auto current = pool.spawned.begin() + pool.settled;
+    for(auto it = pool.spawned.begin(); it != current; ++it) {
+        sqlite3_bind_int64(stmt, 1, *it);
+        // unless this frame handed it out again
+        if(sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_int(stmt, 0) && std::find(current, pool.spawned.end(), *it) == pool.spawned.end())
+            push_free(pool, *it);
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    pool.spawned.erase(pool.spawned.begin(), current);
+    pool.settled = 0;
+    return true;
+}
+
+void sql_spawn(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
+    assert(argc == 1);
+    std::string_view table((const char*) sqlite3_value_text(argv[0]), sqlite3_value_bytes(argv[0]));
+    auto &pool = find_pool(ctx, table);
+    if(!fill_pool(ctx, pool)) return;
+    if(pool.spawn_frame != current_frame()) {
+        pool.spawn_frame = current_frame();
+        pool.settled = pool.spawned.size();
+    }
+    if((pool.free.empty() || pool.settled >= RECLAIM_BATCH) && !reclaim_unused(ctx, pool)) return;
+    if(pool.free.empty()) return;   // null, the insert picks a new id
+    int64_t id = pool.free.back();
+    pool.free.pop_back();
+    pool.is_free.erase(id);
+    pool.spawned.push_back(id);
+    sqlite3_result_int64(ctx, id);
+}
+
+void sql_despawn(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
+    assert(argc == 2);
+    std::string_view table((const char*) sqlite3_value_text(argv[0]), sqlite3_value_bytes(argv[0]));
+    auto &pool = find_pool(ctx, table);
+    if(!fill_pool(ctx, pool)) return;
+    if(!push_free(pool, sqlite3_value_int64(argv[1]))) sqlite3_result_error(ctx, "despawn(): invalid id", -1);
+}
+
+void create_entity_pool_functions(sqlite3 *db) {
+    auto pools = new Pools();
+    int rc = sqlite3_create_function_v2(db, "spawn", 1, SQLITE_UTF8, pools, sql_spawn, nullptr, nullptr,
+        [](void *p) { delete (Pools*) p; });
+    if(rc == SQLITE_OK) rc = sqlite3_create_function(db, "despawn", 2, SQLITE_UTF8, pools, sql_despawn, nullptr, nullptr);
+    if(rc != SQLITE_OK) throw std::runtime_error("failed to create function");
+}
+
+}
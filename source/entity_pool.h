@@ -0,0 +1,19 @@
+#pragma once
+
+struct sqlite3;
+
+namespace sqhell {
+
+// Registers spawn(table) and despawn(table, id), which recycle the ids of dead rows instead of
+// deleting and inserting them. The table needs an `alive` column. despawn() hands the id of a row
+// the script just marked dead to the table's free list and spawn() takes one back, or returns null
+// when there is none, so an upsert either reuses the slot or inserts a new row:
+//   insert into bullets(id, alive, x, y) select spawn('bullets'), 1, x, y from guns where true
+//   on conflict(id) do update set alive = 1, x = excluded.x, y = excluded.y;
+//   update bullets set alive = 0 where alive and age > 1 returning despawn('bullets', id);
+// The free list is filled from the table's dead rows the first time it's used and after restore().
+// Ids spawn() handed out that no insert used (it failed, or filtered them out) are given back from
+// the next frame on, once the free list runs out or enough of them pile up.
+void create_entity_pool_functions(sqlite3 *db);
+
+}
@@ -0,0 +1,139 @@
+#include <file_cache.h>
+#include <archive.h>
+#include <algorithm>
+#include <unordered_map>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <mutex>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace sqhell {
+
+struct CachedFile {
+    void *addr;
+    size_t size;
+    timespec mtime;
+    uint64_t retired = 0;   // retire_count when it was retired
+};
+
+struct PathHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+};
+
+std::unordered_map<std::string, CachedFile, PathHash, std::equal_to<>> file_cache;
+std::vector<CachedFile> retired_files;
+FileCacheStats file_cache_stats{};
+std::mutex file_cache_mutex;
+uint64_t retire_count = 0;
+
+// Threads that map files, e.g. headless worlds, may still read a mapping another thread retired.
+// Each one records how many files were retired when it last called release_retired_files(),
+// and a retired file is only unmapped once all of them got past it.
+struct FileReader;
+std::vector<FileReader*> file_readers;
+
+struct FileReader {
+    uint64_t seen = 0;
+    FileReader() {
+        std::lock_guard lock(file_cache_mutex);
+        seen = retire_count;
+        file_readers.push_back(this);
+    }
+    ~FileReader() {
+        std::lock_guard lock(file_cache_mutex);
+        std::erase(file_readers, this);
+    }
+};
+
+thread_local FileReader file_reader;
+
+void unmap(const CachedFile &file) {
+    if(file.size) munmap(file.addr, file.size);
+}
+
+void retire(const CachedFile &file) {
+    file_cache_stats.mapped_bytes -= file.size;
+    retired_files.push_back(file);
+    retired_files.back().retired = ++retire_count;
+}
+
+bool map_file(const char *path, MappedFile &out) {
+    (void) file_reader;
+    if(archive_lookup(path, out.data, out.size)) {
+        std::lock_guard lock(file_cache_mutex);
+        ++file_cache_stats.hits;
+        return true;
+    }
+
+    struct stat st;
+    if(stat(path, &st) != 0) return false;
+
+    std::lock_guard lock(file_cache_mutex);
+
+    auto it = file_cache.find(std::string_view(path));
+    if(it != file_cache.end()) {
+        auto &file = it->second;
+        if(file.size == (size_t)st.st_size
+        && file.mtime.tv_sec == st.st_mtim.tv_sec
+        && file.mtime.tv_nsec == st.st_mtim.tv_nsec) {
+            ++file_cache_stats.hits;
+            out = {(const char*)file.addr, file.size};
+            return true;
+        }
+        retire(file);
+        file_cache.erase(it);
+    }
+    ++file_cache_stats.misses;
+
+    CachedFile file{nullptr, (size_t)st.st_size, st.st_mtim};
+    if(file.size) {
+        int fd = open(path, O_RDONLY);
+        if(fd < 0) return false;
+        file.addr = mmap(nullptr, file.size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if(file.addr == MAP_FAILED) return false;
+    }
+    file_cache.emplace(path, file);
+    file_cache_stats.mapped_bytes += file.size;
+
+    out = {file.size ? (const char*)file.addr : "", file.size};
+    return true;
+}
+
+void invalidate_file_cache(const char *path) {
+    std::lock_guard lock(file_cache_mutex);
+    if(!path) {
+        for(auto &[_, file] : file_cache) retire(file);
+        file_cache.clear();
+        return;
+    }
+    auto it = file_cache.find(std::string_view(path));
+    if(it == file_cache.end()) return;
+    retire(it->second);
+    file_cache.erase(it);
+}
+
+void release_retired_files() {
+    auto &reader = file_reader;
+    std::lock_guard lock(file_cache_mutex);
+    reader.seen = retire_count;
+    uint64_t seen = retire_count;
+    for(auto r : file_readers) seen = std::min(seen, r->seen);
+    std::erase_if(retired_files, [&](const CachedFile &file) {
+        if(file.retired > seen) return false;
+        unmap(file);
+        return true;
+    });
+}
+
+FileCacheStats get_file_cache_stats() {
+    std::lock_guard lock(file_cache_mutex);
+    return file_cache_stats;
+}
+
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace sqhell {
+
+struct MappedFile {
+    const char *data;
+    size_t size;
+};
+
+struct FileCacheStats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t mapped_bytes;
+};
+
+// Returns the file from the mounted archive if it's there.
+// Otherwise returns a read-only mapping of the file, reusing the previous one
+// as long as the file's mtime and size didn't change.
+// The returned pointer stays valid at least until the calling thread's next release_retired_files().
+// Mappings are private but still backed by the file: replacing it (write + rename, as most
+// editors and build tools do) is safe, but truncating it in place while it's mapped makes
+// reads past the new end raise SIGBUS. The next map_file() of the path sees the new size and
+// remaps it, so only results already handed out (e.g. to SQLite as SQLITE_STATIC) are exposed.
+// Returns false if the file can't be opened.
+bool map_file(const char *path, MappedFile &out);
+
+// Drops cached mappings (all of them if path is null).
+// They are only unmapped in release_retired_files(), since SQLite may still hold pointers into them.
+void invalidate_file_cache(const char *path);
+
+// Must be called when no statement is running on the calling thread, e.g. between frames.
+// Mappings are unmapped once every thread that mapped files called this since they were retired.
+void release_retired_files();
+
+FileCacheStats get_file_cache_stats();
+
+}
@@ -0,0 +1,71 @@
+#include <frame.h>
+#include <logger.h>
+#include <file_cache.h>
+#include <async_loader.h>
+#include <gl_debug.h>
+#include <gpu_timer.h>
+#include <snapshot.h>
+#include <memory_config.h>
+#include <page_cache.h>
+#include <chrono>
+#include <vector>
+#include <cstdio>
+
+namespace sqhell {
+
+thread_local uint64_t frame = 0;
+std::chrono::steady_clock::time_point first_frame_end, last_frame_end;
+const char *frame_times_path = nullptr;
+std::vector<float> frame_times;
+
+void set_frame_times_path(const char *path) {
+    frame_times_path = path;
+    frame_times.reserve(1 << 16);
+}
+
+uint64_t current_frame() {
+    return frame;
+}
+
+void end_world_frame() {
+    release_retired_files();
+    collect_async_loads();
+    memory_end_frame();
+    ++frame;
+}
+
+void end_frame() {
+    gl_debug_end_frame();
+    gpu_timer_end_frame();
+    auto now = std::chrono::steady_clock::now();
+    // frame 0 includes loading the script, so it's left out of the average
+    if(frame == 0) first_frame_end = now;
+    else if(frame_times_path) frame_times.push_back(std::chrono::duration<float, std::milli>(now - last_frame_end).count());
+    last_frame_end = now;
+    end_world_frame();
+}
+
+void write_frame_times() {
+    FILE *f = fopen(frame_times_path, "w");
+    if(!f) {
+        log_message(LOG_ERROR, "Failed to write frame times to %s", frame_times_path);
+        return;
+    }
+    fprintf(f, "frame,ms\n");
+    for(size_t i = 0; i < frame_times.size(); ++i) fprintf(f, "%zu,%.4f\n", i+1, frame_times[i]);
+    fclose(f);
+}
+
+void print_run_report() {
+    if(frame_times_path) write_frame_times();
+    if(frame < 2) return;
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - first_frame_end).count();
+    log_message(LOG_ALWAYS, "Ran %llu frames, avg %.3f ms per frame",
+        (unsigned long long) frame-1, seconds * 1000 / (frame-1));
+    report_gpu_timings();
+    report_snapshots();
+    report_heap_allocations();
+    report_page_cache();
+}
+
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+
+namespace sqhell {
+
+// Number of the frame currently running on this thread. Frame 0 is the one that loads the script.
+uint64_t current_frame();
+
+// Per-frame host work, runs between two passes over the script
+void end_frame();
+
+// The part of end_frame() that only touches the calling thread's state,
+// for headless worlds running on their own threads
+void end_world_frame();
+
+// Writes the duration of every frame to a CSV file at exit
+void set_frame_times_path(const char *path);
+
+// Frame count, average frame time and per-module statistics, printed at exit
+void print_run_report();
+
+}
@@ -0,0 +1,381 @@
+#include <frame_table.h>
+#include <frame.h>
+#include <arena.h>
+#include <sqlite3.h>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <cctype>
+#include <algorithm>
+
+namespace sqhell {
+
+constexpr uint32_t NO_ROW = UINT32_MAX;
+
+struct Cell {
+    uint8_t type;
+    uint32_t size;      // text and blob
+    union {
+        int64_t i;
+        double d;
+        const char *data;   // in the table's arena
+    };
+};
+
+// Open addressing hash from value to the newest row with that value, older rows are chained
+// through `next`. Slots from previous frames are recognized by their generation, so clearing is O(1).
+// Rows where the value is null are chained from `nulls` instead.
+struct HashIndex {
+    struct Slot {
+        uint32_t generation;
+        uint32_t row;
+        uint64_t hash;
+    };
+
+    int column;
+    std::vector<Slot> slots;
+    std::vector<uint32_t> next;     // per row
+    size_t count = 0;
+    uint32_t generation = 1;
+    uint32_t nulls = NO_ROW;
+    bool binary = true;     // the column has no collation, so equal values are equal bytes
+};
+
+struct FrameTable {
+    sqlite3_vtab base;
+    std::vector<std::string> columns;
+    std::vector<Cell> cells;        // rows * columns.size()
+    std::vector<HashIndex> indexes;
+    FrameArena arena;
+    uint64_t frame = UINT64_MAX;
+    size_t rows = 0;
+};
+
+struct FrameTableCursor {
+    sqlite3_vtab_cursor base;
+    uint32_t row;
+    HashIndex *index;   // null for a full scan
+    bool grouped;       // scans every row, one value's chain after the other
+    size_t slot;        // of the next chain in a grouped scan
+};
+
+uint64_t mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    return h;
+}
+
+// Integral reals hash like integers, since 2 = 2.0 in SQL
+uint64_t hash_cell(const Cell &c) {
+    switch(c.type) {
+        case SQLITE_INTEGER: return mix(c.i);
+        case SQLITE_FLOAT: {
+            if(c.d == std::trunc(c.d) && std::abs(c.d) < 9.2e18) return mix((int64_t) c.d);
+            uint64_t bits;
+            memcpy(&bits, &c.d, sizeof(bits));
+            return mix(bits ^ 0x9e3779b97f4a7c15ull);
+        }
+        default: return mix(std::hash<std::string_view>{}({c.data, c.size}) + c.type);
+    }
+}
+
+bool cells_equal(const Cell &a, const Cell &b) {
+    if(a.type == SQLITE_NULL || b.type == SQLITE_NULL) return false;
+    bool a_num = a.type == SQLITE_INTEGER || a.type == SQLITE_FLOAT;
+    bool b_num = b.type == SQLITE_INTEGER || b.type == SQLITE_FLOAT;
+    if(a_num != b_num) return false;
+    if(a_num) {
+        if(a.type == SQLITE_INTEGER && b.type == SQLITE_INTEGER) return a.i == b.i;
+        double x = a.type == SQLITE_INTEGER ? (double) a.i : a.d;
+        double y = b.type == SQLITE_INTEGER ? (double) b.i : b.d;
+        return x == y;
+    }
+    return a.type == b.type && a.size == b.size && memcmp(a.data, b.data, a.size) == 0;
+}
+
+// Cell pointing at the value's own text, only valid during the call
+Cell value_cell(sqlite3_value *v) {
+    Cell c{};
+    c.type = sqlite3_value_type(v);
+    if(c.type == SQLITE_INTEGER) c.i = sqlite3_value_int64(v);
+    else if(c.type == SQLITE_FLOAT) c.d = sqlite3_value_double(v);
+    else if(c.type == SQLITE_TEXT) {
+        c.data = (const char*) sqlite3_value_text(v);
+        c.size = sqlite3_value_bytes(v);
+    } else if(c.type == SQLITE_BLOB) {
+        c.data = (const char*) sqlite3_value_blob(v);
+        c.size = sqlite3_value_bytes(v);
+    }
+    return c;
+}
+
+const Cell &row_cell(FrameTable *table, size_t row, int column) {
+    return table->cells[row * table->columns.size() + column];
+}
+
+void reset_if_stale(FrameTable *table) {
+    if(table->frame == current_frame()) return;
+    table->frame = current_frame();
+    table->rows = 0;
+    table->cells.clear();
+    for(auto &index : table->indexes) {
+        index.next.clear();
+        index.count = 0;
+        index.nulls = NO_ROW;
+        if(++index.generation == 0) {
+            for(auto &slot : index.slots) slot.generation = 0;
+            index.generation = 1;
+        }
+    }
+}
+
+// Returns the slot holding the value's chain, or the empty slot where it would go
+HashIndex::Slot &find_slot(FrameTable *table, HashIndex &index, const Cell &key, uint64_t hash) {
+    size_t mask = index.slots.size() - 1;
+    for(size_t i = hash & mask;; i = (i + 1) & mask) {
+        auto &slot = index.slots[i];
+        if(slot.generation != index.generation) return slot;
+        if(slot.hash == hash && cells_equal(row_cell(table, slot.row, index.column), key)) return slot;
+    }
+}
+
+void grow_index(FrameTable *table, HashIndex &index) {
+    auto old = std::move(index.slots);
+    uint32_t old_generation = index.generation;
+    index.slots.assign(std::max<size_t>(64, old.size() * 2), {0, 0, 0});
+    index.generation = 1;
+    for(auto &slot : old) {
+        if(slot.generation != old_generation) continue;
+        auto &dst = find_slot(table, index, row_cell(table, slot.row, index.column), slot.hash);
+        dst = {index.generation, slot.row, slot.hash};
+    }
+}
+
+void index_row(FrameTable *table, HashIndex &index, uint32_t row) {
+    index.next.push_back(NO_ROW);
+    auto &key = row_cell(table, row, index.column);
+    if(key.type == SQLITE_NULL) {   // never equal to anything, only kept for grouped scans
+        index.next[row] = index.nulls;
+        index.nulls = row;
+        return;
+    }
+    if((index.count + 1) * 2 > index.slots.size()) grow_index(table, index);
+
+    uint64_t hash = hash_cell(key);
+    auto &slot = find_slot(table, index, key, hash);
+    if(slot.generation == index.generation) {
+        index.next[row] = slot.row;
+    } else {
+        slot.generation = index.generation;
+        slot.hash = hash;
+        ++index.count;
+    }
+    slot.row = row;
+}
+
+// Arguments are "name [type] [indexed]"
+int frame_table_connect(sqlite3 *db, void *aux, int argc, const char *const *argv, sqlite3_vtab **vtab, char **err) {
+    auto table = new FrameTable();
+    std::string schema = "create table x(";
+    for(int i = 3; i < argc; ++i) {
+        std::string def = argv[i];
+        bool indexed = false;
+        size_t pos = def.rfind(" indexed");
+        if(pos != std::string::npos && pos + 8 == def.size()) {
+            indexed = true;
+            def.resize(pos);
+        }
+        size_t name_end = def.find_first_of(" \t");
+        table->columns.push_back(def.substr(0, name_end));
+        if(indexed) {
+            table->indexes.push_back({(int) table->columns.size() - 1, {}, {}, 0, 1});
+            auto lower = def;
+            for(char &c : lower) c = (char) tolower((unsigned char) c);
+            table->indexes.back().binary = lower.find("collate") == std::string::npos;
+        }
+        if(i > 3) schema += ", ";
+        schema += def;
+    }
+    schema += ")";
+
+    if(table->columns.empty()) {
+        *err = sqlite3_mprintf("frame_table needs at least one column");
+        delete table;
+        return SQLITE_ERROR;
+    }
+    int rc = sqlite3_declare_vtab(db, schema.c_str());
+    if(rc != SQLITE_OK) {
+        delete table;
+        return rc;
+    }
+    *vtab = &table->base;
+    return SQLITE_OK;
+}
+
+int frame_table_disconnect(sqlite3_vtab *vtab) {
+    delete (FrameTable*) vtab;
+    return SQLITE_OK;
+}
+
+int frame_table_best_index(sqlite3_vtab *vtab, sqlite3_index_info *info) {
+    auto table = (FrameTable*) vtab;
+    for(int i = 0; i < info->nConstraint; ++i) {
+        auto &c = info->aConstraint[i];
+        if(!c.usable || c.op != SQLITE_INDEX_CONSTRAINT_EQ) continue;
+        for(size_t j = 0; j < table->indexes.size(); ++j) {
+            if(table->indexes[j].column != c.iColumn) continue;
+            info->idxNum = j + 1;
+            info->aConstraintUsage[i].argvIndex = 1;
+            info->aConstraintUsage[i].omit = 1;
+            info->estimatedCost = 10;
+            info->estimatedRows = 4;
+            return SQLITE_OK;
+        }
+    }
+    // the current frame's row count, if it's already been filled
+    size_t rows = table->frame == current_frame() ? table->rows : 0;
+    info->idxNum = 0;
+    info->idxStr = (char*) FRAME_TABLE_SCAN;
+    info->estimatedCost = rows + 100;
+    info->estimatedRows = rows + 100;
+    // GROUP BY or DISTINCT on an indexed column: its chains already keep the rows of each value together
+    int distinct = sqlite3_vtab_distinct(info);
+    if(info->nOrderBy != 1 || (distinct != 1 && distinct != 2)) return SQLITE_OK;
+    for(size_t j = 0; j < table->indexes.size(); ++j) {
+        if(table->indexes[j].column != info->aOrderBy[0].iColumn || !table->indexes[j].binary) continue;
+        info->idxNum = -(int)(j + 1);
+        info->orderByConsumed = 1;
+        break;
+    }
+    return SQLITE_OK;
+}
+
+int frame_table_open(sqlite3_vtab *vtab, sqlite3_vtab_cursor **cursor) {
+    auto cur = new FrameTableCursor();
+    *cursor = &cur->base;
+    return SQLITE_OK;
+}
+
+int frame_table_close(sqlite3_vtab_cursor *cursor) {
+    delete (FrameTableCursor*) cursor;
+    return SQLITE_OK;
+}
+
+// Moves a grouped scan to the chain of the next value, and after the last one to the null rows
+void next_group(FrameTableCursor *cur) {
+    auto &index = *cur->index;
+    while(cur->slot < index.slots.size()) {
+        auto &slot = index.slots[cur->slot++];
+        if(slot.generation == index.generation) {
+            cur->row = slot.row;
+            return;
+        }
+    }
+    cur->row = cur->slot++ == index.slots.size() ? index.nulls : NO_ROW;
+}
+
+int frame_table_filter(sqlite3_vtab_cursor *cursor, int idxNum, const char *idxStr, int argc, sqlite3_value **argv) {
+    auto cur = (FrameTableCursor*) cursor;
+    auto table = (FrameTable*) cursor->pVtab;
+    reset_if_stale(table);
+
+    cur->grouped = idxNum < 0;
+    if(idxNum == 0) {
+        cur->index = nullptr;
+        cur->row = table->rows ? 0 : NO_ROW;
+        return SQLITE_OK;
+    }
+    if(cur->grouped) {
+        cur->index = &table->indexes[-idxNum - 1];
+        cur->slot = 0;
+        next_group(cur);
+        return SQLITE_OK;
+    }
+    cur->index = &table->indexes[idxNum - 1];
+    cur->row = NO_ROW;
+    auto key = value_cell(argv[0]);
+    if(key.type == SQLITE_NULL || cur->index->slots.empty()) return SQLITE_OK;
+    auto &slot = find_slot(table, *cur->index, key, hash_cell(key));
+    if(slot.generation == cur->index->generation) cur->row = slot.row;
+    return SQLITE_OK;
+}
+
+int frame_table_next(sqlite3_vtab_cursor *cursor) {
+    auto cur = (FrameTableCursor*) cursor;
+    auto table = (FrameTable*) cursor->pVtab;
+    if(cur->index) {
+        cur->row = cur->index->next[cur->row];
+        if(cur->row == NO_ROW && cur->grouped) next_group(cur);
+    } else if(++cur->row >= table->rows) cur->row = NO_ROW;
+    return SQLITE_OK;
+}
+
+int frame_table_eof(sqlite3_vtab_cursor *cursor) {
+    return ((FrameTableCursor*) cursor)->row == NO_ROW;
+}
+
+int frame_table_column(sqlite3_vtab_cursor *cursor, sqlite3_context *ctx, int col) {
+    auto cur = (FrameTableCursor*) cursor;
+    auto &cell = row_cell((FrameTable*) cursor->pVtab, cur->row, col);
+    switch(cell.type) {
+        case SQLITE_INTEGER: sqlite3_result_int64(ctx, cell.i); break;
+        case SQLITE_FLOAT: sqlite3_result_double(ctx, cell.d); break;
+        // rows can't change during the frame, so the arena outlives any statement reading them
+        case SQLITE_TEXT: sqlite3_result_text(ctx, cell.data, cell.size, SQLITE_STATIC); break;
+        case SQLITE_BLOB: sqlite3_result_blob(ctx, cell.data, cell.size, SQLITE_STATIC); break;
+        default: sqlite3_result_null(ctx);
+    }
+    return SQLITE_OK;
+}
+
+int frame_table_rowid(sqlite3_vtab_cursor *cursor, sqlite3_int64 *rowid) {
+    *rowid = ((FrameTableCursor*) cursor)->row + 1;
+    return SQLITE_OK;
+}
+
+int frame_table_update(sqlite3_vtab *vtab, int argc, sqlite3_value **argv, sqlite3_int64 *rowid) {
+    auto table = (FrameTable*) vtab;
+    if(argc == 1 || sqlite3_value_type(argv[0]) != SQLITE_NULL) {
+        vtab->zErrMsg = sqlite3_mprintf("frame_table rows can't be updated or deleted, they're gone next frame");
+        return SQLITE_CONSTRAINT_VTAB;
+    }
+    reset_if_stale(table);
+
+    uint32_t row = table->rows++;
+    for(size_t i = 0; i < table->columns.size(); ++i) {
+        Cell cell = value_cell(argv[2 + i]);
+        if(cell.type == SQLITE_TEXT || cell.type == SQLITE_BLOB) cell.data = table->arena.copy(cell.data, cell.size);
+        table->cells.push_back(cell);
+    }
+    for(auto &index : table->indexes) index_row(table, index, row);
+    *rowid = row + 1;
+    return SQLITE_OK;
+}
+
+sqlite3_module frame_table_module = {
+    .iVersion = 0,
+    .xCreate = frame_table_connect,
+    .xConnect = frame_table_connect,
+    .xBestIndex = frame_table_best_index,
+    .xDisconnect = frame_table_disconnect,
+    .xDestroy = frame_table_disconnect,
+    .xOpen = frame_table_open,
+    .xClose = frame_table_close,
+    .xFilter = frame_table_filter,
+    .xNext = frame_table_next,
+    .xEof = frame_table_eof,
+    .xColumn = frame_table_column,
+    .xRowid = frame_table_rowid,
+    .xUpdate = frame_table_update,
+};
+
+void create_frame_table_module(sqlite3 *db) {
+    int rc = sqlite3_create_module(db, "frame_table", &frame_table_module, nullptr);
+    if(rc != SQLITE_OK) throw std::runtime_error("failed to create virtual table module");
+}
+
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+struct sqlite3;
+
+namespace sqhell {
+
+// Registers the frame_table virtual table module for rows that only live for one frame:
+//   create virtual table damageEvents using frame_table(target_id integer indexed, attacker_id, damage real)
+// Rows are appended to host memory and all of them disappear when the next frame
+// first touches the table, in O(1). Columns marked `indexed` get a hash index used for
+// `column = value` lookups, and for GROUP BY and DISTINCT on the column without sorting.
+// Rows can't be updated or deleted.
+void create_frame_table_module(sqlite3 *db);
+
+// idxStr of the scans that read all of a frame table's rows. The query plan report doesn't flag
+// them, since the table only holds what the current frame inserted into it.
+constexpr const char *FRAME_TABLE_SCAN = "current frame";
+
+}
@@ -0,0 +1,145 @@
+#include <gl_debug.h>
+#include <frame.h>
+#include <logger.h>
+#include <vtab.h>
+#include <glad/glad.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstring>
+
+namespace sqhell {
+
+struct DebugMessage {
+    GLenum source, type, severity;
+    GLuint id;
+    std::string text;       // text of the first occurrence
+    uint64_t count;
+    uint64_t frame_count;   // occurrences during the current frame
+    uint64_t last_frame_count; // occurrences during the previous frame
+    uint64_t first_frame, last_frame;
+};
+
+// The same id can be reported with different severities, which are counted apart
+struct DebugMessageKey {
+    GLenum source, type, severity;
+    GLuint id;
+    bool operator==(const DebugMessageKey&) const = default;
+};
+
+struct DebugMessageKeyHash {
+    size_t operator()(const DebugMessageKey &k) const {
+        uint64_t h = (uint64_t)(k.source & 0xffff) << 48 | (uint64_t)(k.type & 0xffff) << 32 | k.id;
+        return std::hash<uint64_t>{}(h ^ (uint64_t) k.severity * 0x9e3779b97f4a7c15ull);
+    }
+};
+
+bool gl_debug = false;
+std::vector<DebugMessage> debug_messages;
+std::unordered_map<DebugMessageKey, size_t, DebugMessageKeyHash> debug_message_index;
+
+void enable_gl_debug() { gl_debug = true; }
+bool gl_debug_enabled() { return gl_debug; }
+
+const char *debug_source_name(GLenum source) {
+    switch(source) {
+        case GL_DEBUG_SOURCE_API: return "api";
+        case GL_DEBUG_SOURCE_WINDOW_SYSTEM: return "window system";
+        case GL_DEBUG_SOURCE_SHADER_COMPILER: return "shader compiler";
+        case GL_DEBUG_SOURCE_THIRD_PARTY: return "third party";
+        case GL_DEBUG_SOURCE_APPLICATION: return "application";
+        default: return "other";
+    }
+}
+
+const char *debug_type_name(GLenum type) {
+    switch(type) {
+        case GL_DEBUG_TYPE_ERROR: return "error";
+        case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: return "deprecated";
+        case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR: return "undefined";
+        case GL_DEBUG_TYPE_PORTABILITY: return "portability";
+        case GL_DEBUG_TYPE_PERFORMANCE: return "performance";
+        case GL_DEBUG_TYPE_MARKER: return "marker";
+        case GL_DEBUG_TYPE_PUSH_GROUP: return "push group";
+        case GL_DEBUG_TYPE_POP_GROUP: return "pop group";
+        default: return "other";
+    }
+}
+
+const char *debug_severity_name(GLenum severity) {
+    switch(severity) {
+        case GL_DEBUG_SEVERITY_HIGH: return "high";
+        case GL_DEBUG_SEVERITY_MEDIUM: return "medium";
+        case GL_DEBUG_SEVERITY_LOW: return "low";
+        default: return "notification";
+    }
+}
+
+void GLAPIENTRY debug_callback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar *message, const void *user) {
+    DebugMessageKey key{source, type, severity, id};
+    uint64_t frame = current_frame();
+
+    auto [it, inserted] = debug_message_index.try_emplace(key, debug_messages.size());
+    if(inserted) {
+        debug_messages.push_back({source, type, severity, id, std::string(message, length < 0 ? strlen(message) : length), 0, 0, 0, frame, frame});
+        if(severity != GL_DEBUG_SEVERITY_NOTIFICATION)
+            log_message(type == GL_DEBUG_TYPE_ERROR ? LOG_ERROR : LOG_WARN, "GL %s (%s): %s",
+                debug_type_name(type), debug_severity_name(severity), debug_messages.back().text.c_str());
+    }
+    auto &msg = debug_messages[it->second];
+    msg.count++;
+    msg.frame_count++;
+    msg.last_frame = frame;
+}
+
+void install_gl_debug_callback() {
+    GLint flags = 0;
+    glGetIntegerv(GL_CONTEXT_FLAGS, &flags);
+    if(!(flags & GL_CONTEXT_FLAG_DEBUG_BIT)) {
+        log_message(LOG_WARN, "GL debug output requested, but the context is not a debug context");
+        return;
+    }
+    glEnable(GL_DEBUG_OUTPUT);
+    // keeps the callback on the thread running the script
+    glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+    glDebugMessageCallback(debug_callback, nullptr);
+    glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr, GL_TRUE);
+}
+
+void gl_debug_end_frame() {
+    for(auto &msg : debug_messages) {
+        msg.last_frame_count = msg.frame_count;
+        msg.frame_count = 0;
+    }
+}
+
+struct GlDebugLogTable {
+    static constexpr const char *schema =
+        "create table x(id integer, source text, type text, severity text, message text,"
+        " count integer, frame_count integer, first_frame integer, last_frame integer)";
+
+    static size_t row_count() { return debug_messages.size(); }
+
+    static void column(size_t row, sqlite3_context *ctx, int col) {
+        auto &msg = debug_messages[row];
+        switch(col) {
+            case 0: sqlite3_result_int64(ctx, msg.id); break;
+            case 1: sqlite3_result_text(ctx, debug_source_name(msg.source), -1, SQLITE_STATIC); break;
+            case 2: sqlite3_result_text(ctx, debug_type_name(msg.type), -1, SQLITE_STATIC); break;
+            case 3: sqlite3_result_text(ctx, debug_severity_name(msg.severity), -1, SQLITE_STATIC); break;
+            // copied, GL calls made by the same statement may add messages and move the strings
+            case 4: sqlite3_result_text(ctx, msg.text.c_str(), msg.text.size(), SQLITE_TRANSIENT); break;
+            case 5: sqlite3_result_int64(ctx, msg.count); break;
+            // count for the last complete frame, the current one is still running
+            case 6: sqlite3_result_int64(ctx, msg.last_frame_count); break;
+            case 7: sqlite3_result_int64(ctx, msg.first_frame); break;
+            case 8: sqlite3_result_int64(ctx, msg.last_frame); break;
+        }
+    }
+};
+
+void create_gl_debug_log_module(sqlite3 *db) {
+    create_eponymous_table<GlDebugLogTable>(db, "gl_debug_log");
+}
+
+}
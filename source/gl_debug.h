@@ -0,0 +1,21 @@
+#pragma once
+
+struct sqlite3;
+
+namespace sqhell {
+
+// Requests a debug context for the window created by glfwCreateWindow().
+// Off by default, so release runs don't pay for any of this.
+void enable_gl_debug();
+bool gl_debug_enabled();
+
+// Installs glDebugMessageCallback, needs a current context with loaded GL functions
+void install_gl_debug_callback();
+
+void gl_debug_end_frame();
+
+// Registers the eponymous gl_debug_log virtual table.
+// Messages are aggregated by (source, type, severity, id), so each one appears once with its counts.
+void create_gl_debug_log_module(sqlite3 *db);
+
+}
@@ -0,0 +1,137 @@
+#include <gpu_timer.h>
+#include <frame.h>
+#include <logger.h>
+#include <vtab.h>
+#include <glad/glad.h>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <algorithm>
+
+namespace sqhell {
+
+// Results stay in gpu_timings for this many frames
+constexpr uint64_t TIMING_HISTORY = 240;
+// Queries still unavailable after this many frames are read with a blocking call
+constexpr uint64_t MAX_QUERY_LATENCY = 8;
+
+struct PendingQuery {
+    GLuint query;
+    int name;
+    uint64_t frame;
+};
+
+struct GpuTiming {
+    uint64_t frame;
+    int name;
+    uint64_t ns;
+};
+
+struct GpuTimingTotal {
+    uint64_t count, ns, max_ns;
+};
+
+struct NameHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+};
+
+std::vector<std::string> timer_names;
+std::unordered_map<std::string, int, NameHash, std::equal_to<>> timer_name_index;
+std::vector<GpuTimingTotal> timer_totals;
+
+std::vector<GLuint> free_queries;
+std::deque<PendingQuery> pending_queries;
+std::deque<GpuTiming> gpu_timings;
+PendingQuery active_query{0, -1, 0};
+
+int intern_timer_name(const char *name) {
+    auto it = timer_name_index.find(std::string_view(name));
+    if(it != timer_name_index.end()) return it->second;
+    timer_names.emplace_back(name);
+    timer_totals.push_back({0, 0, 0});
+    timer_name_index.emplace(name, (int)timer_names.size() - 1);
+    return timer_names.size() - 1;
+}
+
+const char *gpu_timer_begin(const char *name) {
+    if(active_query.query) return "gpuTimerBegin(): GPU timer sections can't nest";
+
+    if(free_queries.empty()) {
+        free_queries.resize(16);
+        glGenQueries(free_queries.size(), free_queries.data());
+    }
+    active_query = {free_queries.back(), intern_timer_name(name), current_frame()};
+    free_queries.pop_back();
+    glBeginQuery(GL_TIME_ELAPSED, active_query.query);
+    return nullptr;
+}
+
+const char *gpu_timer_end() {
+    if(!active_query.query) return "gpuTimerEnd(): no GPU timer section is running";
+    glEndQuery(GL_TIME_ELAPSED);
+    pending_queries.push_back(active_query);
+    active_query = {0, -1, 0};
+    return nullptr;
+}
+
+void gpu_timer_end_frame() {
+    uint64_t frame = current_frame();
+
+    // queries finish in order, so stop at the first one that isn't ready
+    while(!pending_queries.empty()) {
+        auto &q = pending_queries.front();
+        GLuint available = GL_FALSE;
+        if(frame - q.frame < MAX_QUERY_LATENCY) {
+            glGetQueryObjectuiv(q.query, GL_QUERY_RESULT_AVAILABLE, &available);
+            if(!available) break;
+        }
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(q.query, GL_QUERY_RESULT, &ns);
+
+        gpu_timings.push_back({q.frame, q.name, ns});
+        auto &total = timer_totals[q.name];
+        total.count++;
+        total.ns += ns;
+        total.max_ns = std::max<uint64_t>(total.max_ns, ns);
+
+        free_queries.push_back(q.query);
+        pending_queries.pop_front();
+    }
+
+    while(!gpu_timings.empty() && gpu_timings.front().frame + TIMING_HISTORY < frame)
+        gpu_timings.pop_front();
+}
+
+void report_gpu_timings() {
+    for(size_t i = 0; i < timer_names.size(); ++i) {
+        auto &total = timer_totals[i];
+        if(!total.count) continue;
+        log_message(LOG_ALWAYS, "  GPU %-24s %8llu samples, avg %8.3f ms, max %8.3f ms",
+            timer_names[i].c_str(), (unsigned long long) total.count,
+            total.ns / 1e6 / total.count, total.max_ns / 1e6);
+    }
+}
+
+struct GpuTimingsTable {
+    static constexpr const char *schema = "create table x(frame integer, name text, ns integer)";
+
+    static size_t row_count() { return gpu_timings.size(); }
+
+    static void column(size_t row, sqlite3_context *ctx, int col) {
+        auto &timing = gpu_timings[row];
+        switch(col) {
+            case 0: sqlite3_result_int64(ctx, timing.frame); break;
+            case 1: sqlite3_result_text(ctx, timer_names[timing.name].c_str(), -1, SQLITE_TRANSIENT); break;
+            case 2: sqlite3_result_int64(ctx, timing.ns); break;
+        }
+    }
+};
+
+void create_gpu_timings_module(sqlite3 *db) {
+    create_eponymous_table<GpuTimingsTable>(db, "gpu_timings");
+}
+
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+struct sqlite3;
+
+namespace sqhell {
+
+// Starts timing a GPU section with a GL_TIME_ELAPSED query.
+// Sections can't nest. Returns an error message or null.
+const char *gpu_timer_begin(const char *name);
+const char *gpu_timer_end();
+
+// Reads back finished queries without waiting for the GPU, unless they are too old
+void gpu_timer_end_frame();
+
+// Per-section totals for the end-of-run report
+void report_gpu_timings();
+
+// Registers the eponymous gpu_timings(frame, name, ns) table with the last few seconds of results
+void create_gpu_timings_module(sqlite3 *db);
+
+}
@@ -0,0 +1,96 @@
+#include <host_params.h>
+#include <sqlite3.h>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <cassert>
+
+namespace sqhell {
+
+struct HostParam {
+    int type = SQLITE_NULL;
+    int64_t integer = 0;
+    double real = 0;
+    std::string bytes;  // text and blobs
+};
+
+// References to the parameters stay valid as more are added
+using ParamRegistry = std::unordered_map<std::string, HostParam>;
+
+constexpr const char *REGISTRY_KEY = "sqhell_params";
+
+ParamRegistry &registry(sqlite3 *db) {
+    auto params = (ParamRegistry*) sqlite3_get_clientdata(db, REGISTRY_KEY);
+    assert(params && "create_param_functions() wasn't called");
+    return *params;
+}
+
+void set_value(HostParam &param, sqlite3_value *value) {
+    param.type = sqlite3_value_type(value);
+    switch(param.type) {
+        case SQLITE_INTEGER: param.integer = sqlite3_value_int64(value); break;
+        case SQLITE_FLOAT: param.real = sqlite3_value_double(value); break;
+        case SQLITE_TEXT:
+        case SQLITE_BLOB: {
+            auto data = param.type == SQLITE_TEXT ? (const char*) sqlite3_value_text(value) : (const char*) sqlite3_value_blob(value);
+            param.bytes.assign(data ? data : "", sqlite3_value_bytes(value));
+            break;
+        }
+    }
+}
+
+void set_frame_params(sqlite3 *db, double t, double dt, uint64_t frame) {
+    auto &params = registry(db);
+    params["t"] = {.type = SQLITE_FLOAT, .real = t};
+    params["dt"] = {.type = SQLITE_FLOAT, .real = dt};
+    params["frame"] = {.type = SQLITE_INTEGER, .integer = (int64_t) frame};
+}
+
+std::vector<ParamBinding> find_params(sqlite3 *db, sqlite3_stmt *stmt) {
+    std::vector<ParamBinding> found;
+    auto &params = registry(db);
+    int count = sqlite3_bind_parameter_count(stmt);
+    for(int i = 1; i <= count; ++i) {
+        auto name = sqlite3_bind_parameter_name(stmt, i);
+        if(!name || name[0] == '?') continue;
+        found.push_back({i, &params[name + 1]});
+    }
+    return found;
+}
+
+void bind_params(sqlite3_stmt *stmt, const std::vector<ParamBinding> &params) {
+    for(auto &[index, param] : params) {
+        switch(param->type) {
+            case SQLITE_INTEGER: sqlite3_bind_int64(stmt, index, param->integer); break;
+            case SQLITE_FLOAT: sqlite3_bind_double(stmt, index, param->real); break;
+            case SQLITE_TEXT: sqlite3_bind_text(stmt, index, param->bytes.data(), (int) param->bytes.size(), SQLITE_TRANSIENT); break;
+            case SQLITE_BLOB: sqlite3_bind_blob(stmt, index, param->bytes.data(), (int) param->bytes.size(), SQLITE_TRANSIENT); break;
+            default: sqlite3_bind_null(stmt, index);
+        }
+    }
+}
+
+void sql_setParam(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
+    assert(argc == 2);
+    auto &params = *(ParamRegistry*) sqlite3_user_data(ctx);
+    auto name = (const char*) sqlite3_value_text(argv[0]);
+    if(!name) {
+        sqlite3_result_error(ctx, "setParam(): name must not be null", -1);
+        return;
+    }
+    set_value(params[name], argv[1]);
+    sqlite3_result_value(ctx, argv[1]);
+}
+
+void destroy_registry(void *p) {
+    delete (ParamRegistry*) p;
+}
+
+void create_param_functions(sqlite3 *db) {
+    auto params = new ParamRegistry();
+    sqlite3_set_clientdata(db, REGISTRY_KEY, params, destroy_registry);
+    int rc = sqlite3_create_function(db, "setParam", 2, SQLITE_UTF8, params, sql_setParam, nullptr, nullptr);
+    if(rc != SQLITE_OK) throw std::runtime_error("failed to create function");
+}
+
+}
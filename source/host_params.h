@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+namespace sqhell {
+
+struct HostParam;
+
+// Host parameters are values the host binds into every script statement that refers to them as
+// `:name` (or `@name`, `$name`), so reading them costs no join with a one-row table:
+//   update entities set x = x + vx * :dt;
+// The host sets :t (seconds), :dt (seconds since the previous frame) and :frame at the start of
+// every frame. setParam(name, value) declares more of them from the script and returns value.
+// Parameters nothing has set are null. They can't be used in views or triggers.
+void create_param_functions(sqlite3 *db);
+
+// Sets :t, :dt and :frame for the frame about to run
+void set_frame_params(sqlite3 *db, double t, double dt, uint64_t frame);
+
+struct ParamBinding {
+    int index;
+    const HostParam *param;
+};
+
+// Finds the host parameters `stmt` refers to, in the registry of `db`
+std::vector<ParamBinding> find_params(sqlite3 *db, sqlite3_stmt *stmt);
+
+// Binds their current values, before each run of the statement
+void bind_params(sqlite3_stmt *stmt, const std::vector<ParamBinding> &params);
+
+}
@@ -0,0 +1,209 @@
+#include <input_replay.h>
+#include <file_cache.h>
+#include <logger.h>
+#include <sqlite3.h>
+#include <GLFW/glfw3.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace sqhell {
+
+// Recording layout: magic, then one entry per call, in call order: [u8 kind][varint payload].
+// Times are stored as the zigzag encoded difference from the previous time in nanoseconds,
+// keys as the zigzag encoded key code followed by the returned state, and close flags as the
+// returned value. INPUT_FRAME has no payload.
+constexpr char RECORDING_MAGIC[8] = "SQHREC2";
+
+enum InputKind : uint8_t { INPUT_FRAME, INPUT_TIME, INPUT_KEY, INPUT_SHOULD_CLOSE };
+
+enum InputMode { INPUT_LIVE, INPUT_RECORD, INPUT_REPLAY };
+
+struct Recording {
+    InputMode mode = INPUT_LIVE;
+    int64_t time_ns = 0;
+    uint64_t frames = 0;
+
+    FILE *out = nullptr;
+    std::vector<uint8_t> buf;   // entries of the current frame
+
+    const uint8_t *pos = nullptr, *end = nullptr;
+    sqlite3 *db = nullptr;      // whose tables are hashed when the replay finishes
+
+    // the last frame is usually cut short by exit(), its entries are kept so the replay gets there too
+    ~Recording() {
+        if(!out) return;
+        fwrite(buf.data(), 1, buf.size(), out);
+        fclose(out);
+    }
+};
+
+Recording recording;
+
+uint64_t zigzag(int64_t v) { return (uint64_t) v << 1 ^ (uint64_t)(v >> 63); }
+int64_t unzigzag(uint64_t v) { return (int64_t)(v >> 1) ^ -(int64_t)(v & 1); }
+
+bool start_input_recording(const char *path) {
+    recording.out = fopen(path, "wb");
+    if(!recording.out) return false;
+    fwrite(RECORDING_MAGIC, 1, sizeof(RECORDING_MAGIC), recording.out);
+    recording.mode = INPUT_RECORD;
+    return true;
+}
+
+void log_database_hashes(sqlite3 *db);
+
+// At exit, so a replay that ends with the script calling exit() in its last frame logs them too
+void finish_replay() {
+    if(recording.mode != INPUT_REPLAY || recording.pos != recording.end || !recording.db) return;
+    log_message(LOG_ALWAYS, "Replay finished after %llu frames, database contents:", (unsigned long long) recording.frames);
+    log_database_hashes(recording.db);
+}
+
+bool start_input_replay(const char *path) {
+    MappedFile file;
+    if(!map_file(path, file) || file.size < sizeof(RECORDING_MAGIC)) return false;
+    if(memcmp(file.data, RECORDING_MAGIC, sizeof(RECORDING_MAGIC)) != 0) return false;
+    // the recording is read once, so the mapping is never retired
+    recording.pos = (const uint8_t*) file.data + sizeof(RECORDING_MAGIC);
+    recording.end = (const uint8_t*) file.data + file.size;
+    recording.mode = INPUT_REPLAY;
+    std::atexit(finish_replay);
+    return true;
+}
+
+void record_varint(uint64_t value) {
+    for(; value >= 0x80; value >>= 7) recording.buf.push_back(value | 0x80);
+    recording.buf.push_back(value);
+}
+
+void record(InputKind kind, uint64_t value) {
+    recording.buf.push_back(kind);
+    record_varint(value);
+}
+
+[[noreturn]] void replay_diverged(const char *reason) {
+    log_message(LOG_ERROR, "Replay diverged in frame %llu: %s", (unsigned long long) recording.frames, reason);
+    recording.mode = INPUT_LIVE;
+    exit(EXIT_FAILURE);
+}
+
+uint64_t replay_varint() {
+    uint64_t value = 0;
+    for(int shift = 0;; shift += 7) {
+        if(recording.pos == recording.end) replay_diverged("the recording is truncated");
+        uint8_t b = *recording.pos++;
+        value |= (uint64_t)(b & 0x7f) << shift;
+        if(!(b & 0x80)) return value;
+    }
+}
+
+uint64_t replay(InputKind kind) {
+    if(recording.pos == recording.end) replay_diverged("the recording ended in the middle of the frame");
+    if(*recording.pos != kind) replay_diverged("the script asked for different input than it did when recording");
+    ++recording.pos;
+    return replay_varint();
+}
+
+double input_time() {
+    if(recording.mode == INPUT_REPLAY) {
+        recording.time_ns += unzigzag(replay(INPUT_TIME));
+        return recording.time_ns / 1e9;
+    }
+    double t = glfwGetTime();
+    if(recording.mode != INPUT_RECORD) return t;
+    // rounded, so the recording run sees exactly what the replay will
+    int64_t ns = llround(t * 1e9);
+    record(INPUT_TIME, zigzag(ns - recording.time_ns));
+    recording.time_ns = ns;
+    return ns / 1e9;
+}
+
+int input_key(GLFWwindow *window, int key) {
+    if(recording.mode == INPUT_REPLAY) {
+        if(unzigzag(replay(INPUT_KEY)) != key) replay_diverged("the script asked for a different key than it did when recording");
+        return replay_varint();
+    }
+    int state = glfwGetKey(window, key);
+    if(recording.mode == INPUT_RECORD) {
+        record(INPUT_KEY, zigzag(key));
+        record_varint(state);
+    }
+    return state;
+}
+
+int input_window_should_close(GLFWwindow *window) {
+    if(recording.mode == INPUT_REPLAY) return replay(INPUT_SHOULD_CLOSE);
+    int close = glfwWindowShouldClose(window);
+    if(recording.mode == INPUT_RECORD) record(INPUT_SHOULD_CLOSE, close);
+    return close;
+}
+
+// FNV-1a over the table's rows in rowid order
+uint64_t hash_table(sqlite3 *db, const char *name) {
+    uint64_t h = 0xcbf29ce484222325ull;
+    auto add = [&](const void *data, size_t n) {
+        for(size_t i = 0; i < n; ++i) h = (h ^ ((const uint8_t*) data)[i]) * 0x100000001b3ull;
+    };
+
+    // WITHOUT ROWID tables have no rowid, but are scanned in primary key order anyway
+    sqlite3_stmt *stmt;
+    int rc = SQLITE_ERROR;
+    for(auto format : {"select * from \"%w\" order by rowid", "select * from \"%w\""}) {
+        char *sql = sqlite3_mprintf(format, name);
+        rc = sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr);
+        sqlite3_free(sql);
+        if(rc == SQLITE_OK) break;
+    }
+    if(rc != SQLITE_OK) return 0;
+    while(sqlite3_step(stmt) == SQLITE_ROW) {
+        for(int i = 0; i < sqlite3_column_count(stmt); ++i) {
+            uint8_t type = sqlite3_column_type(stmt, i);
+            add(&type, 1);
+            if(type == SQLITE_INTEGER) {
+                int64_t v = sqlite3_column_int64(stmt, i);
+                add(&v, sizeof(v));
+            } else if(type == SQLITE_FLOAT) {
+                double v = sqlite3_column_double(stmt, i);
+                add(&v, sizeof(v));
+            } else if(type != SQLITE_NULL) {
+                auto data = sqlite3_column_blob(stmt, i);
+                add(data, sqlite3_column_bytes(stmt, i));
+            }
+        }
+    }
+    sqlite3_finalize(stmt);
+    return h;
+}
+
+// Per table, since some tables hold host pointers (e.g. the GLFW window) that differ between runs
+void log_database_hashes(sqlite3 *db) {
+    sqlite3_stmt *stmt;
+    const char *sql = "select name from sqlite_schema where type = 'table' and name not like 'sqlite_%' order by name";
+    if(sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) return;
+    while(sqlite3_step(stmt) == SQLITE_ROW) {
+        auto name = (const char*) sqlite3_column_text(stmt, 0);
+        log_message(LOG_ALWAYS, "  table %-24s %016llx", name, (unsigned long long) hash_table(db, name));
+    }
+    sqlite3_finalize(stmt);
+}
+
+void input_replay_end_frame(sqlite3 *db) {
+    recording.db = db;
+    if(recording.mode == INPUT_RECORD) {
+        recording.buf.push_back(INPUT_FRAME);
+        fwrite(recording.buf.data(), 1, recording.buf.size(), recording.out);
+        recording.buf.clear();
+    } else if(recording.mode == INPUT_REPLAY) {
+        if(recording.pos == recording.end || *recording.pos != INPUT_FRAME)
+            replay_diverged("the script asked for less input than it did when recording");
+        ++recording.pos;
+        ++recording.frames;
+        if(recording.pos == recording.end) exit(EXIT_SUCCESS);
+    }
+}
+
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+struct sqlite3;
+struct GLFWwindow;
+
+namespace sqhell {
+
+// Records every value the time and input bindings return to a file
+bool start_input_recording(const char *path);
+
+// Returns the values from a recording instead of asking GLFW.
+// The run ends when the recording does.
+bool start_input_replay(const char *path);
+
+// glfwGetTime(), glfwGetKey() and glfwWindowShouldClose(), recorded or replayed
+double input_time();
+int input_key(GLFWwindow *window, int key);
+int input_window_should_close(GLFWwindow *window);
+
+// Marks the end of the frame in the recording. When the replay runs out of frames it exits, and
+// a replay that got to the end of the recording logs a hash of the database contents at exit
+// (also when the script exits in the last frame), so runs can be compared.
+void input_replay_end_frame(sqlite3 *db);
+
+}
@@ -0,0 +1,261 @@
+#include <logger.h>
+#include <sqlite3.h>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <string>
+#include <cstring>
+#include <algorithm>
+#include <iterator>
+#include <strings.h>
+#include <cstdarg>
+
+namespace sqhell {
+
+// Byte ring with lock-free producers and a single consumer. A producer reserves space by moving
+// head forward with a compare-and-swap, copies its message in, then publishes its size in the
+// commit slot of the message's first byte. The consumer reads messages in order until it finds
+// an empty slot, and clears the slots it read before handing their space back.
+// Each message is stored as [u8 level][u8 newline][fields...] where each field is
+// [u8 sqlite type][payload], and starts on a multiple of MESSAGE_ALIGN.
+constexpr size_t RING_SIZE = 1 << 20;
+constexpr size_t RING_MASK = RING_SIZE - 1;
+constexpr size_t MESSAGE_HEADER = 2;
+constexpr size_t MESSAGE_ALIGN = 8;
+
+const char *level_names[] = {"TRACE", "DEBUG", "INFO", "WARN", "ERROR"};
+
+struct Logger {
+    char ring[RING_SIZE];
+    std::atomic<uint32_t> committed[RING_SIZE / MESSAGE_ALIGN] = {};   // size of the message starting there, 0 until it's complete
+    alignas(64) std::atomic<uint64_t> head{0};  // end of the reserved space
+    alignas(64) std::atomic<uint64_t> tail{0};
+    alignas(64) std::atomic<int> level{LOG_INFO};
+    std::atomic<uint64_t> written{0}, dropped{0}, filtered{0};
+    std::atomic<bool> running{false};
+    std::thread writer;
+    FILE *out = stdout;
+
+    ~Logger() { stop_logger(); }
+};
+
+Logger logger;
+
+void ring_write(uint64_t pos, const void *src, size_t n) {
+    size_t off = pos & RING_MASK;
+    size_t first = std::min(n, RING_SIZE - off);
+    memcpy(logger.ring + off, src, first);
+    memcpy(logger.ring, (const char*)src + first, n - first);
+}
+
+void ring_read(uint64_t pos, void *dst, size_t n) {
+    size_t off = pos & RING_MASK;
+    size_t first = std::min(n, RING_SIZE - off);
+    memcpy(dst, logger.ring + off, first);
+    memcpy((char*)dst + first, logger.ring, n - first);
+}
+
+int parse_log_level(const char *name) {
+    for(int i = 0; i < (int)std::size(level_names); ++i)
+        if(strcasecmp(name, level_names[i]) == 0) return i;
+    return -1;
+}
+
+void set_log_level(int level) { logger.level.store(level, std::memory_order_relaxed); }
+int get_log_level() { return logger.level.load(std::memory_order_relaxed); }
+
+LogStats get_log_stats() {
+    return {logger.written.load(), logger.dropped.load(), logger.filtered.load()};
+}
+
+uint64_t aligned_size(uint32_t size) {
+    return (size + MESSAGE_ALIGN - 1) & ~(MESSAGE_ALIGN - 1);
+}
+
+std::atomic<uint32_t> &commit_slot(uint64_t start) {
+    return logger.committed[(start & RING_MASK) / MESSAGE_ALIGN];
+}
+
+void end_message(uint64_t start, uint32_t size) {
+    commit_slot(start).store(size, std::memory_order_release);
+}
+
+// Reserves space for the message and writes its header.
+// Returns false if the message doesn't fit.
+bool begin_message(uint32_t size, int level, bool newline, uint64_t &start, uint64_t &pos) {
+    uint64_t head = logger.head.load(std::memory_order_relaxed);
+    do {
+        // acquire, the consumer cleared the commit slots of the space it handed back
+        uint64_t tail = logger.tail.load(std::memory_order_acquire);
+        if(aligned_size(size) > RING_SIZE - (head - tail)) {
+            logger.dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+    } while(!logger.head.compare_exchange_weak(head, head + aligned_size(size), std::memory_order_relaxed));
+
+    uint8_t header[MESSAGE_HEADER] = {(uint8_t) level, newline};
+    ring_write(head, header, sizeof(header));
+    start = head;
+    pos = head + sizeof(header);
+    return true;
+}
+
+
+void log_values(int level, bool newline, int argc, sqlite3_value **argv) {
+    if(level < get_log_level()) {
+        logger.filtered.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    uint32_t size = MESSAGE_HEADER;
+    for(int i = 0; i < argc; ++i) {
+        switch(sqlite3_value_type(argv[i])) {
+            case SQLITE_INTEGER:
+            case SQLITE_FLOAT: size += 1 + 8; break;
+            case SQLITE_NULL: size += 1; break;
+            default:
+                sqlite3_value_text(argv[i]);
+                size += 1 + 4 + sqlite3_value_bytes(argv[i]);
+        }
+    }
+
+    uint64_t start, pos;
+    if(!begin_message(size, level, newline, start, pos)) return;
+
+    for(int i = 0; i < argc; ++i) {
+        uint8_t type = sqlite3_value_type(argv[i]);
+        ring_write(pos++, &type, 1);
+        if(type == SQLITE_INTEGER) {
+            int64_t v = sqlite3_value_int64(argv[i]);
+            ring_write(pos, &v, 8); pos += 8;
+        } else if(type == SQLITE_FLOAT) {
+            double v = sqlite3_value_double(argv[i]);
+            ring_write(pos, &v, 8); pos += 8;
+        } else if(type != SQLITE_NULL) {
+            uint32_t len = sqlite3_value_bytes(argv[i]);
+            ring_write(pos, &len, 4); pos += 4;
+            ring_write(pos, sqlite3_value_text(argv[i]), len); pos += len;
+        }
+    }
+
+    end_message(start, size);
+}
+
+void log_message(int level, const char *fmt, ...) {
+    if(level < get_log_level()) {
+        logger.filtered.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    char text[1024];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(text, sizeof(text), fmt, args);
+    va_end(args);
+    uint32_t len = std::clamp(n, 0, (int)sizeof(text)-1);
+
+    uint32_t size = MESSAGE_HEADER + 1 + 4 + len;
+    uint64_t start, pos;
+    if(!begin_message(size, level, true, start, pos)) return;
+    uint8_t type = SQLITE_TEXT;
+    ring_write(pos++, &type, 1);
+    ring_write(pos, &len, 4); pos += 4;
+    ring_write(pos, text, len); pos += len;
+    end_message(start, size);
+}
+
+// Formats the queued messages into buf, up to the first one still being written.
+// Returns false if there were none.
+bool drain(std::string &buf) {
+    uint64_t start = logger.tail.load(std::memory_order_relaxed), tail = start;
+
+    char num[32];
+    while(uint32_t size = commit_slot(tail).load(std::memory_order_acquire)) {
+        uint8_t header[MESSAGE_HEADER];
+        ring_read(tail, header, sizeof(header));
+        uint64_t pos = tail + sizeof(header), end = tail + size;
+
+        if(header[0] < LOG_ALWAYS) {
+            buf += '[';
+            buf += level_names[header[0]];
+            buf += "] ";
+        }
+        while(pos < end) {
+            uint8_t type;
+            ring_read(pos++, &type, 1);
+            if(type == SQLITE_INTEGER) {
+                int64_t v;
+                ring_read(pos, &v, 8); pos += 8;
+                buf += std::to_string(v);
+            } else if(type == SQLITE_FLOAT) {
+                double v;
+                ring_read(pos, &v, 8); pos += 8;
+                // same formatting SQLite uses when converting REAL to TEXT
+                buf += sqlite3_snprintf(sizeof(num), num, "%!.15g", v);
+            } else if(type == SQLITE_NULL) {
+                buf += "NULL";
+            } else {
+                uint32_t len;
+                ring_read(pos, &len, 4); pos += 4;
+                size_t off = buf.size();
+                buf.resize(off + len);
+                ring_read(pos, buf.data() + off, len); pos += len;
+            }
+        }
+        if(header[1]) buf += '\n';
+
+        commit_slot(tail).store(0, std::memory_order_relaxed);
+        tail += aligned_size(size);
+        logger.written.fetch_add(1, std::memory_order_relaxed);
+    }
+    if(tail == start) return false;
+    logger.tail.store(tail, std::memory_order_release);
+    return true;
+}
+
+void writer_loop() {
+    std::string buf;
+    while(logger.running.load(std::memory_order_acquire)) {
+        buf.clear();
+        if(drain(buf)) {
+            fwrite(buf.data(), 1, buf.size(), logger.out);
+            fflush(logger.out);
+        } else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+}
+
+void start_logger(const char *path) {
+    if(logger.running) return;
+    if(path) {
+        logger.out = fopen(path, "w");
+        if(!logger.out) {
+            fprintf(stderr, "Failed to open log file %s, logging to stdout\n", path);
+            logger.out = stdout;
+        }
+    }
+    logger.running = true;
+    logger.writer = std::thread(writer_loop);
+}
+
+void stop_logger() {
+    bool was_running = logger.running.exchange(false);
+    if(was_running) logger.writer.join();
+
+    std::string buf;
+    while(drain(buf)) {
+        fwrite(buf.data(), 1, buf.size(), logger.out);
+        buf.clear();
+    }
+    fflush(logger.out);
+
+    if(was_running && logger.dropped)
+        fprintf(stderr, "Logger dropped %llu messages (ring buffer full)\n", (unsigned long long) logger.dropped.load());
+    if(logger.out != stdout) {
+        fclose(logger.out);
+        logger.out = stdout;
+    }
+}
+
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+
+struct sqlite3_value;
+
+namespace sqhell {
+
+enum LogLevel : uint8_t {
+    LOG_TRACE, LOG_DEBUG, LOG_INFO, LOG_WARN, LOG_ERROR,
+    LOG_ALWAYS // print()/println(), never filtered and written without a prefix
+};
+
+// Returns -1 if name isn't a valid level
+int parse_log_level(const char *name);
+
+struct LogStats {
+    uint64_t written;
+    uint64_t dropped;
+    uint64_t filtered;
+};
+
+// Starts the background writer thread. Output goes to stdout if path is null.
+void start_logger(const char *path);
+void stop_logger();
+
+void set_log_level(int level);
+int get_log_level();
+LogStats get_log_stats();
+
+// Enqueues the values without converting them to text, the writer thread does that.
+// Messages below the current log level are discarded before touching argv.
+// Safe to call from several threads, messages from one thread stay in order.
+void log_values(int level, bool newline, int argc, sqlite3_value **argv);
+
+// printf-style message from the host, same threading rules as log_values
+void log_message(int level, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+}
@@ -0,0 +1,107 @@
+#include <memory_config.h>
+#include <frame.h>
+#include <page_cache.h>
+#include <logger.h>
+#include <sqlite3.h>
+#include <imgui/imgui.h>
+#include <algorithm>
+#include <cstdlib>
+
+namespace sqhell {
+
+// Per thread, so every world counts its own frames
+thread_local uint64_t allocations = 0;
+thread_local uint64_t frame_start_allocations = 0;
+thread_local uint64_t last_frame_allocations = 0;
+thread_local uint64_t allocation_free_since = 0;    // first frame of the current run without allocations
+thread_local uint64_t max_frame_allocations = 0;
+
+sqlite3_mem_methods system_methods;
+
+void *count_malloc(int size) {
+    ++allocations;
+    return system_methods.xMalloc(size);
+}
+
+void *count_realloc(void *ptr, int size) {
+    ++allocations;
+    return system_methods.xRealloc(ptr, size);
+}
+
+void *imgui_malloc(size_t size, void*) {
+    ++allocations;
+    return malloc(size);
+}
+
+void imgui_free(void *ptr, void*) {
+    free(ptr);
+}
+
+// Without a fixed heap, per-transaction bookkeeping (journal bitvecs, savepoints)
+// still goes to malloc() for every statement that writes
+bool configure_sqlite_heap(int mib) {
+    size_t size = (size_t) mib << 20;
+    void *buf = malloc(size);
+    if(!buf) return false;
+    if(sqlite3_config(SQLITE_CONFIG_HEAP, buf, (int) std::min<size_t>(size, INT32_MAX), 64) == SQLITE_OK) return true;
+    log_message(LOG_WARN, "Fixed SQLite heap unavailable (SQLite built without SQLITE_ENABLE_MEMSYS5), using malloc()");
+    free(buf);
+    return false;
+}
+
+void configure_sqlite_memory(const MemoryConfig &config) {
+    if(config.heap_mib <= 0 || !configure_sqlite_heap(config.heap_mib)) {
+        sqlite3_config(SQLITE_CONFIG_GETMALLOC, &system_methods);
+        sqlite3_mem_methods methods = system_methods;
+        methods.xMalloc = count_malloc;
+        methods.xRealloc = count_realloc;
+        sqlite3_config(SQLITE_CONFIG_MALLOC, &methods);
+    }
+
+    if(config.slab_page_cache && use_slab_page_cache(true)) {
+        // slabs are mapped by the page cache itself
+    } else if(config.page_cache_pages > 0) {
+        int header = 0;
+        sqlite3_config(SQLITE_CONFIG_PCACHE_HDRSZ, &header);
+        // default page size, pages of other sizes fall back to the heap
+        int slot = 4096 + header;
+        void *buf = malloc((size_t) slot * config.page_cache_pages);
+        if(buf) sqlite3_config(SQLITE_CONFIG_PAGECACHE, buf, slot, config.page_cache_pages);
+    }
+
+    ImGui::SetAllocatorFunctions(imgui_malloc, imgui_free);
+}
+
+void configure_connection_memory(sqlite3 *db, const MemoryConfig &config) {
+    int rc = sqlite3_db_config(db, SQLITE_DBCONFIG_LOOKASIDE, nullptr, config.lookaside_slot_size, config.lookaside_slots);
+    if(rc != SQLITE_OK) log_message(LOG_WARN, "Failed to configure lookaside memory: %s", sqlite3_errstr(rc));
+}
+
+void memory_end_frame() {
+    last_frame_allocations = allocations - frame_start_allocations;
+    frame_start_allocations = allocations;
+    // frame 0 loads the script
+    if(current_frame() == 0) return;
+    max_frame_allocations = std::max(max_frame_allocations, last_frame_allocations);
+    if(last_frame_allocations) allocation_free_since = 0;
+    else if(!allocation_free_since) allocation_free_since = current_frame();
+}
+
+void count_heap_allocation() {
+    ++allocations;
+}
+
+uint64_t last_frame_heap_allocations() {
+    return last_frame_allocations;
+}
+
+void report_heap_allocations() {
+    if(allocation_free_since)
+        log_message(LOG_ALWAYS, "  Heap allocations: none since frame %llu (max %llu per frame before that)",
+            (unsigned long long) allocation_free_since, (unsigned long long) max_frame_allocations);
+    else
+        log_message(LOG_ALWAYS, "  Heap allocations: %llu in the last frame, max %llu per frame",
+            (unsigned long long) last_frame_allocations, (unsigned long long) max_frame_allocations);
+}
+
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+
+struct sqlite3;
+
+namespace sqhell {
+
+struct MemoryConfig {
+    int heap_mib = 0;               // fixed heap for all of SQLite's allocations, 0 uses malloc()
+    bool slab_page_cache = false;   // see page_cache.h
+    int page_cache_pages = 4096;    // preallocated slots for SQLite's default page cache, shared by all connections
+    int lookaside_slot_size = 1200;
+    int lookaside_slots = 2048;     // per connection
+};
+
+// Must run before SQLite is initialized: gives SQLite the slab or a preallocated page cache, and either
+// a fixed heap (memsys5) or a counting wrapper around malloc() for everything else
+void configure_sqlite_memory(const MemoryConfig &config);
+
+// Per-connection lookaside buffer for small allocations (records, expression trees, ...).
+// Must run right after opening the connection.
+void configure_connection_memory(sqlite3 *db, const MemoryConfig &config);
+
+// Heap allocations are counted per thread when made by SQLite, ImGui or, in the sqhell executable
+// (which replaces the global operator new), C++ code.
+// Page cache, lookaside and fixed heap allocations don't reach malloc() and aren't counted.
+void memory_end_frame();
+void count_heap_allocation();
+uint64_t last_frame_heap_allocations();
+void report_heap_allocations();
+
+}
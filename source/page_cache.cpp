@@ -0,0 +1,223 @@
+#include <page_cache.h>
+#include <logger.h>
+#include <sqlite3.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <sys/mman.h>
+
+namespace sqhell {
+
+constexpr size_t SLAB_SIZE = 2 << 20;
+
+// Slabs of destroyed caches kept for the next ones. Statements that sort or materialize a subquery
+// build a temporary in-memory table every run, with a cache created and destroyed along with it.
+constexpr size_t MAX_SPARE_SLABS = 16;
+
+// Each slot is [SlabPage][page][extra]
+struct SlabPage {
+    sqlite3_pcache_page base;   // must come first, SQLite only sees this part
+    unsigned key;
+};
+
+constexpr size_t SLOT_HEADER = (sizeof(SlabPage) + 15) & ~size_t(15);
+
+// One per pager. SQLite never uses a cache from two threads at once, so there's no locking.
+struct SlabCache {
+    sqlite3_pcache *fallback = nullptr;     // SQLite's own cache, for purgeable pagers
+    int page_size, extra_size;
+    size_t slot_size;
+    std::vector<SlabPage*> pages;       // indexed by page number, in-memory databases are dense
+    std::vector<SlabPage*> free_slots;
+    std::vector<char*> slabs;
+    char *next = nullptr, *slab_end = nullptr;  // unused part of the newest slab
+    size_t count = 0;
+};
+
+std::atomic<size_t> cached_pages{0}, slab_bytes{0};
+std::atomic<uint64_t> slabs_mapped{0}, slabs_reused{0};
+
+std::mutex spare_mutex;
+std::vector<char*> spare_slabs;
+
+sqlite3_pcache_methods2 default_methods;
+
+// 2 MiB aligned, so transparent huge pages can back the whole slab
+char *map_slab() {
+    {
+        std::lock_guard lock(spare_mutex);
+        if(!spare_slabs.empty()) {
+            auto slab = spare_slabs.back();
+            spare_slabs.pop_back();
+            ++slabs_reused;
+            return slab;
+        }
+    }
+    void *raw = mmap(nullptr, SLAB_SIZE * 2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(raw == MAP_FAILED) return nullptr;
+    char *begin = (char*) raw;
+    char *slab = (char*)(((uintptr_t) begin + SLAB_SIZE - 1) & ~(uintptr_t)(SLAB_SIZE - 1));
+    if(slab > begin) munmap(begin, slab - begin);
+    munmap(slab + SLAB_SIZE, begin + SLAB_SIZE * 2 - (slab + SLAB_SIZE));
+    madvise(slab, SLAB_SIZE, MADV_HUGEPAGE);
+    slab_bytes += SLAB_SIZE;
+    ++slabs_mapped;
+    return slab;
+}
+
+void release_slab(char *slab) {
+    {
+        std::lock_guard lock(spare_mutex);
+        if(spare_slabs.size() < MAX_SPARE_SLABS) {
+            spare_slabs.push_back(slab);
+            return;
+        }
+    }
+    munmap(slab, SLAB_SIZE);
+    slab_bytes -= SLAB_SIZE;
+}
+
+SlabPage *allocate_slot(SlabCache *cache) {
+    if(!cache->free_slots.empty()) {
+        auto page = cache->free_slots.back();
+        cache->free_slots.pop_back();
+        return page;
+    }
+    if(cache->next + cache->slot_size > cache->slab_end) {
+        char *slab = map_slab();
+        if(!slab) return nullptr;
+        cache->slabs.push_back(slab);
+        cache->next = slab;
+        cache->slab_end = slab + SLAB_SIZE;
+    }
+    auto page = (SlabPage*) cache->next;
+    page->base.pBuf = cache->next + SLOT_HEADER;
+    page->base.pExtra = cache->next + SLOT_HEADER + cache->page_size;
+    cache->next += cache->slot_size;
+    return page;
+}
+
+void remove_page(SlabCache *cache, SlabPage *page) {
+    cache->pages[page->key] = nullptr;
+    cache->free_slots.push_back(page);
+    --cache->count;
+    --cached_pages;
+}
+
+int slab_init(void*) { return default_methods.xInit(default_methods.pArg); }
+void slab_shutdown(void*) { default_methods.xShutdown(default_methods.pArg); }
+
+// Only caches that can't evict anyway, those of in-memory databases and temporary tables, get slabs.
+// A purgeable pager (a database on a VFS) has to keep to its cache_size, so it keeps SQLite's cache.
+sqlite3_pcache *slab_create(int page_size, int extra_size, int purgeable) {
+    auto cache = new SlabCache();
+    if(purgeable && !(cache->fallback = default_methods.xCreate(page_size, extra_size, purgeable))) {
+        delete cache;
+        return nullptr;
+    }
+    cache->page_size = page_size;
+    cache->extra_size = extra_size;
+    cache->slot_size = (SLOT_HEADER + page_size + extra_size + 15) & ~size_t(15);
+    return (sqlite3_pcache*) cache;
+}
+
+// Nothing is ever evicted, so there's no size to keep to
+void slab_cachesize(sqlite3_pcache *p, int size) {
+    if(auto fallback = ((SlabCache*) p)->fallback) default_methods.xCachesize(fallback, size);
+}
+
+void slab_shrink(sqlite3_pcache *p) {
+    if(auto fallback = ((SlabCache*) p)->fallback) default_methods.xShrink(fallback);
+}
+
+int slab_pagecount(sqlite3_pcache *p) {
+    auto cache = (SlabCache*) p;
+    return cache->fallback ? default_methods.xPagecount(cache->fallback) : cache->count;
+}
+
+sqlite3_pcache_page *slab_fetch(sqlite3_pcache *p, unsigned key, int create) {
+    auto cache = (SlabCache*) p;
+    if(cache->fallback) return default_methods.xFetch(cache->fallback, key, create);
+    if(key < cache->pages.size() && cache->pages[key]) return &cache->pages[key]->base;
+    if(!create) return nullptr;
+
+    auto page = allocate_slot(cache);
+    if(!page) return nullptr;
+    page->key = key;
+    memset(page->base.pExtra, 0, cache->extra_size);
+    if(key >= cache->pages.size()) cache->pages.resize(std::max<size_t>(key + 1, cache->pages.size() * 2));
+    cache->pages[key] = page;
+    ++cache->count;
+    ++cached_pages;
+    return &page->base;
+}
+
+void slab_unpin(sqlite3_pcache *p, sqlite3_pcache_page *page, int discard) {
+    auto cache = (SlabCache*) p;
+    if(cache->fallback) default_methods.xUnpin(cache->fallback, page, discard);
+    else if(discard) remove_page(cache, (SlabPage*) page);
+}
+
+void slab_rekey(sqlite3_pcache *p, sqlite3_pcache_page *pcache_page, unsigned old_key, unsigned new_key) {
+    auto cache = (SlabCache*) p;
+    if(cache->fallback) return default_methods.xRekey(cache->fallback, pcache_page, old_key, new_key);
+    auto page = (SlabPage*) pcache_page;
+    if(new_key < cache->pages.size() && cache->pages[new_key]) remove_page(cache, cache->pages[new_key]);
+    if(new_key >= cache->pages.size()) cache->pages.resize(std::max<size_t>(new_key + 1, cache->pages.size() * 2));
+    cache->pages[old_key] = nullptr;
+    cache->pages[new_key] = page;
+    page->key = new_key;
+}
+
+// Drops pages >= limit, only walks the truncated part of the array
+void slab_truncate(sqlite3_pcache *p, unsigned limit) {
+    auto cache = (SlabCache*) p;
+    if(cache->fallback) return default_methods.xTruncate(cache->fallback, limit);
+    for(size_t key = limit; key < cache->pages.size(); ++key)
+        if(cache->pages[key]) remove_page(cache, cache->pages[key]);
+    if(limit < cache->pages.size()) cache->pages.resize(limit);
+}
+
+void slab_destroy(sqlite3_pcache *p) {
+    auto cache = (SlabCache*) p;
+    if(cache->fallback) default_methods.xDestroy(cache->fallback);
+    for(auto slab : cache->slabs) release_slab(slab);
+    cached_pages -= cache->count;
+    delete cache;
+}
+
+const sqlite3_pcache_methods2 slab_methods = {
+    .iVersion = 1,
+    .pArg = nullptr,
+    .xInit = slab_init,
+    .xShutdown = slab_shutdown,
+    .xCreate = slab_create,
+    .xCachesize = slab_cachesize,
+    .xPagecount = slab_pagecount,
+    .xFetch = slab_fetch,
+    .xUnpin = slab_unpin,
+    .xRekey = slab_rekey,
+    .xTruncate = slab_truncate,
+    .xDestroy = slab_destroy,
+    .xShrink = slab_shrink,
+};
+
+bool use_slab_page_cache(bool enable) {
+    static bool have_default = false;
+    if(!have_default) {
+        if(sqlite3_config(SQLITE_CONFIG_GETPCACHE2, &default_methods) != SQLITE_OK) return false;
+        have_default = true;
+    }
+    return sqlite3_config(SQLITE_CONFIG_PCACHE2, enable ? &slab_methods : &default_methods) == SQLITE_OK;
+}
+
+void report_page_cache() {
+    if(!slab_bytes) return;
+    log_message(LOG_ALWAYS, "  Page cache: %zu pages in %.1f MiB of slabs (%llu mapped, %llu reused)", cached_pages.load(),
+        slab_bytes / 1048576.0, (unsigned long long) slabs_mapped.load(), (unsigned long long) slabs_reused.load());
+}
+
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+namespace sqhell {
+
+// Switches SQLite between its default page cache and the slab cache below.
+// Like every sqlite3_config() call it only works before sqlite3_initialize()
+// or after sqlite3_shutdown().
+//
+// The slab cache is meant for in-memory databases: pages never spill, so there is
+// no LRU and no eviction, pages are looked up by number in a flat array, and they come
+// from 2 MiB slabs that the kernel can back with huge pages. Slabs of destroyed caches,
+// like those of the temporary tables a sort builds, are reused by the next ones.
+// Purgeable caches, of databases on a VFS, stay with SQLite's cache and its cache_size.
+bool use_slab_page_cache(bool enable);
+
+// Pages held by slab caches and the memory mapped for them, for the end-of-run report
+void report_page_cache();
+
+}
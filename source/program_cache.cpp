@@ -0,0 +1,159 @@
+#include <program_cache.h>
+#include <file_cache.h>
+#include <glad/glad.h>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <sys/stat.h>
+
+namespace sqhell {
+
+std::string program_cache_dir = ".sqhell_cache";
+bool program_cache_enabled = true;
+ProgramCacheStats program_cache_stats{};
+
+void set_program_cache_dir(const char *dir) {
+    program_cache_enabled = dir != nullptr;
+    if(dir) program_cache_dir = dir;
+}
+
+ProgramCacheStats get_program_cache_stats() {
+    return program_cache_stats;
+}
+
+// FNV-1a
+uint64_t hash_str(uint64_t h, const char *s) {
+    for(; *s; ++s) h = (h ^ (unsigned char)*s) * 0x100000001b3ull;
+    return (h ^ 0xff) * 0x100000001b3ull; // separator, so ("ab","c") != ("a","bc")
+}
+
+std::string cache_path(const char *vertex_src, const char *fragment_src) {
+    uint64_t h = 0xcbf29ce484222325ull;
+    for(GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION})
+        h = hash_str(h, (const char*) glGetString(name));
+    h = hash_str(h, vertex_src);
+    h = hash_str(h, fragment_src);
+
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.bin", (unsigned long long) h);
+    return program_cache_dir + name;
+}
+
+bool driver_supports_binaries() {
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    return formats > 0;
+}
+
+// Cache file layout: [GLenum binary format][binary]
+GLuint load_cached_program(const std::string &path) {
+    MappedFile file;
+    if(!map_file(path.c_str(), file) || file.size <= sizeof(GLenum)) return 0;
+
+    GLenum format;
+    memcpy(&format, file.data, sizeof(format));
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, format, file.data + sizeof(format), file.size - sizeof(format));
+    // we don't need this mapping anymore, the next program would be in a different file
+    invalidate_file_cache(path.c_str());
+
+    GLint ok = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &ok);
+    if(ok) return program;
+    // driver update, different GPU etc.
+    glDeleteProgram(program);
+    return 0;
+}
+
+void store_cached_program(GLuint program, const std::string &path) {
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if(length <= 0) return;
+
+    std::vector<char> binary(sizeof(GLenum) + length);
+    GLenum format;
+    glGetProgramBinary(program, length, nullptr, &format, binary.data() + sizeof(GLenum));
+    memcpy(binary.data(), &format, sizeof(format));
+
+    mkdir(program_cache_dir.c_str(), 0755);
+    // write to a temporary file first so other instances never see a partial binary
+    std::string tmp = path + ".tmp";
+    FILE *f = fopen(tmp.c_str(), "wb");
+    if(!f) return;
+    bool ok = fwrite(binary.data(), 1, binary.size(), f) == binary.size();
+    ok = fclose(f) == 0 && ok;
+    if(ok) rename(tmp.c_str(), path.c_str());
+    else remove(tmp.c_str());
+}
+
+GLuint compile_shader(GLenum type, const char *src, std::string &error) {
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &src, nullptr);
+    glCompileShader(shader);
+
+    GLint ok = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+    if(ok) return shader;
+
+    char log[1024] = "";
+    glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+    error = log;
+    glDeleteShader(shader);
+    return 0;
+}
+
+GLuint link_program(const char *vertex_src, const char *fragment_src, bool retrievable, std::string &error) {
+    GLuint vs = compile_shader(GL_VERTEX_SHADER, vertex_src, error);
+    if(!vs) return 0;
+    GLuint fs = compile_shader(GL_FRAGMENT_SHADER, fragment_src, error);
+    if(!fs) {
+        glDeleteShader(vs);
+        return 0;
+    }
+
+    GLuint program = glCreateProgram();
+    if(retrievable) glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glAttachShader(program, vs);
+    glAttachShader(program, fs);
+    glLinkProgram(program);
+    glDetachShader(program, vs);
+    glDetachShader(program, fs);
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+
+    GLint ok = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &ok);
+    if(ok) return program;
+
+    char log[1024] = "";
+    glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+    error = log;
+    glDeleteProgram(program);
+    return 0;
+}
+
+unsigned build_program(const char *vertex_src, const char *fragment_src, std::string &error) {
+    auto start = std::chrono::steady_clock::now();
+
+    bool use_cache = program_cache_enabled && driver_supports_binaries();
+    std::string path;
+    GLuint program = 0;
+
+    if(use_cache) {
+        path = cache_path(vertex_src, fragment_src);
+        program = load_cached_program(path);
+    }
+    if(program) {
+        ++program_cache_stats.hits;
+    } else {
+        ++program_cache_stats.misses;
+        program = link_program(vertex_src, fragment_src, use_cache, error);
+        if(program && use_cache) store_cached_program(program, path);
+    }
+
+    program_cache_stats.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return program;
+}
+
+}
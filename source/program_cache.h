@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+
+namespace sqhell {
+
+struct ProgramCacheStats {
+    int hits;
+    int misses;
+    double seconds; // total time spent in build_program()
+};
+
+// Directory for cached program binaries, null disables the cache
+void set_program_cache_dir(const char *dir);
+
+// Links a program from vertex and fragment shader sources.
+// Tries the on-disk binary cache first (keyed by the sources and the driver version)
+// and stores the result there after compiling from source.
+// Returns 0 and sets error on failure. Requires a current GL context.
+unsigned build_program(const char *vertex_src, const char *fragment_src, std::string &error);
+
+ProgramCacheStats get_program_cache_stats();
+
+}
@@ -0,0 +1,101 @@
+#include <query_plans.h>
+#include <script.h>
+#include <logger.h>
+#include <frame_table.h>
+#include <sqlite3.h>
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+
+namespace sqhell {
+
+std::atomic<bool> strict_hot_plans = false;
+
+void set_strict_hot_plans(bool strict) {
+    strict_hot_plans = strict;
+}
+
+std::string query_plan(sqlite3 *db, sqlite3_stmt *stmt) {
+    std::string plan;
+    auto sql = std::string("explain query plan ") + sqlite3_sql(stmt);
+    sqlite3_stmt *explain;
+    if(sqlite3_prepare_v2(db, sql.c_str(), -1, &explain, nullptr) != SQLITE_OK) return plan;
+    std::vector<std::pair<int, int>> depths; // id -> depth
+    while(sqlite3_step(explain) == SQLITE_ROW) {
+        int id = sqlite3_column_int(explain, 0), parent = sqlite3_column_int(explain, 1);
+        auto found = std::ranges::find(depths, parent, &std::pair<int, int>::first);
+        int depth = found != depths.end() ? found->second + 1 : 0;
+        depths.push_back({id, depth});
+        plan += "    " + std::string(2 * depth, ' ') + (const char*) sqlite3_column_text(explain, 3) + "\n";
+    }
+    sqlite3_finalize(explain);
+    return plan;
+}
+
+// `subqueries` are the names the plan materializes or runs as co-routines, whose own steps are checked
+bool is_finding(std::string_view step, const std::vector<std::string_view> &subqueries) {
+    if(step.starts_with("SCAN ")) {
+        if(step == "SCAN CONSTANT ROW") return false;
+        auto vtab = step.find(" VIRTUAL TABLE INDEX ");
+        if(vtab != std::string_view::npos) {
+            auto index = step.substr(vtab + 21);    // idxNum:idxStr
+            return index.starts_with("0:") && index.substr(2) != FRAME_TABLE_SCAN;
+        }
+        auto name = step.substr(5, step.find(' ', 5) - 5);
+        return std::ranges::find(subqueries, name) == subqueries.end();
+    }
+    return step.starts_with("CORRELATED ") || step.find("USE TEMP B-TREE") != std::string_view::npos ||
+        step.find("AUTOMATIC") != std::string_view::npos;
+}
+
+// Plan steps worth a look, separated by "; "
+std::string findings(sqlite3 *db, sqlite3_stmt *stmt) {
+    std::string found;
+    auto plan = query_plan(db, stmt);
+    std::vector<std::string_view> subqueries;
+    for(std::string_view lines(plan); !lines.empty();) {
+        auto line = lines.substr(0, lines.find('\n'));
+        lines.remove_prefix(std::min(line.size() + 1, lines.size()));
+        line.remove_prefix(std::min(line.find_first_not_of(' '), line.size()));
+        for(std::string_view prefix : {"MATERIALIZE ", "CO-ROUTINE "})
+            if(line.starts_with(prefix)) subqueries.push_back(line.substr(prefix.size()));
+    }
+    std::string_view lines(plan);
+    while(!lines.empty()) {
+        auto line = lines.substr(0, lines.find('\n'));
+        lines.remove_prefix(std::min(line.size() + 1, lines.size()));
+        line.remove_prefix(std::min(line.find_first_not_of(' '), line.size()));
+        if(!is_finding(line, subqueries) || found.find(line) != std::string::npos) continue;
+        if(!found.empty()) found += "; ";
+        found += line;
+    }
+    return found;
+}
+
+void report_query_plans(sqlite3 *db, const char *path, const Script &script) {
+    std::vector<std::pair<const ScriptStatement*, std::string>> flagged;
+    int checked = 0;
+    for(auto &s : script.statements) {
+        if(!s.stmt || s.setup) continue;
+        ++checked;
+        auto found = findings(db, s.stmt);
+        if(!found.empty()) flagged.push_back({&s, std::move(found)});
+    }
+    log_message(LOG_INFO, "Query plan report for %s: %zu of %d main loop statements scan, sort or use correlated subqueries",
+        path, flagged.size(), checked);
+    bool failed = false;
+    for(auto &[s, found] : flagged) {
+        log_message(s->hot ? LOG_WARN : LOG_INFO, "  line %d%s: %s", s->line, s->hot ? " (@hot)" : "", found.c_str());
+        if(s->hot && strict_hot_plans) {
+            fprintf(stderr, "ERROR IN SCRIPT (%s:%d): @hot statement has %s\n", path, s->line, found.c_str());
+            failed = true;
+        }
+    }
+    if(failed) exit(EXIT_FAILURE);
+}
+
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+namespace sqhell {
+
+struct Script;
+
+// EXPLAIN QUERY PLAN output of the statement, one indented line per step
+std::string query_plan(sqlite3 *db, sqlite3_stmt *stmt);
+
+// Fail startup when a statement marked `-- @hot` has a finding in the query plan report
+void set_strict_hot_plans(bool strict);
+
+// Logs the query plan findings of every statement after the script's `-- @main-loop` (all of
+// them if it has none): full scans (SCAN, except of a constant row, of a subquery's result, of a
+// virtual table with a nonzero idxNum, which the modules here use for constrained lookups, or of
+// a frame table, see FRAME_TABLE_SCAN), USE TEMP B-TREE, AUTOMATIC indexes and CORRELATED subqueries.
+// Findings are warnings for statements marked `-- @hot`, and exit in strict mode.
+void report_query_plans(sqlite3 *db, const char *path, const Script &script);
+
+}
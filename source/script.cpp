@@ -0,0 +1,285 @@
+#include <script.h>
+#include <file_cache.h>
+#include <logger.h>
+#include <query_plans.h>
+#include <sqlite3.h>
+#include <algorithm>
+#include <charconv>
+#include <ranges>
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+
+namespace sqhell {
+
+void execute_stmt(sqlite3 *db, sqlite3_stmt *stmt) {
+    //fprintf(stderr, "EXECUTING: %s\n", sqlite3_sql(stmt));
+    while(true) {
+        int rc = sqlite3_step(stmt);
+        if(rc == SQLITE_ROW) continue;
+        if(rc == SQLITE_DONE) {
+            sqlite3_reset(stmt);
+            break;
+        }
+        fprintf(stderr, "ERROR: %d %s\n", rc, sqlite3_errmsg(db));
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Steps the guard of an `-- @if` block, which passes when its first column is true
+bool guard_passes(sqlite3 *db, sqlite3_stmt *stmt) {
+    int rc = sqlite3_step(stmt);
+    if(rc != SQLITE_ROW && rc != SQLITE_DONE) {
+        fprintf(stderr, "ERROR: %d %s\n", rc, sqlite3_errmsg(db));
+        exit(EXIT_FAILURE);
+    }
+    bool pass = rc == SQLITE_ROW && sqlite3_column_type(stmt, 0) != SQLITE_NULL && sqlite3_column_double(stmt, 0) != 0;
+    sqlite3_reset(stmt);
+    return pass;
+}
+
+void run_range(sqlite3 *db, Script &script, size_t begin, size_t end);
+
+// Repeats the block of a @repeat until a pass changes nothing. `changes` are the ones
+// the first `passes` passes made, which already ran.
+void repeat_block(sqlite3 *db, Script &script, size_t i, int passes, int64_t changes) {
+    auto &s = script.statements[i];
+    while(changes && passes < s.max_iterations) {
+        int64_t before = sqlite3_total_changes64(db);
+        run_range(db, script, i + 1, s.block_end);
+        changes = sqlite3_total_changes64(db) - before;
+        ++passes;
+    }
+    s.last_iterations = passes;
+    log_message(LOG_TRACE, "@repeat at line %d: %d passes", s.line, passes);
+    if(changes && !s.warned) {
+        s.warned = true;
+        log_message(LOG_WARN, "@repeat at line %d stopped after %d passes without converging", s.line, passes);
+    }
+}
+
+// Runs one statement and returns the index of the next one to run
+size_t run_statement(sqlite3 *db, Script &script, size_t i) {
+    auto &s = script.statements[i];
+    switch(s.kind) {
+        case StatementKind::sql:
+            bind_params(s.stmt, s.params);
+            execute_stmt(db, s.stmt);
+            return i + 1;
+        case StatementKind::if_guard:
+            bind_params(s.stmt, s.params);
+            return guard_passes(db, s.stmt) ? i + 1 : s.block_end;
+        case StatementKind::repeat:
+            repeat_block(db, script, i, 0, 1);
+            return s.block_end;
+    }
+    return i + 1;
+}
+
+void run_range(sqlite3 *db, Script &script, size_t begin, size_t end) {
+    if(!script.profile) {
+        for(size_t i = begin; i < end;)
+            i = run_statement(db, script, i);
+        return;
+    }
+    // blocks count the time of their statements too
+    for(size_t i = begin; i < end;) {
+        auto &s = script.statements[i];
+        auto start = std::chrono::steady_clock::now();
+        i = run_statement(db, script, i);
+        s.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        s.runs++;
+        s.iterations += s.last_iterations;
+    }
+}
+
+void run_script(sqlite3 *db, Script &script) {
+    run_range(db, script, 0, script.statements.size());
+}
+
+// `-- @name arguments` comments are directives for the loader
+bool is_directive(const char *sql, const char *end) {
+    if(!(sql+1 < end && sql[0] == '-' && sql[1] == '-')) return false;
+    for(sql += 2; sql < end && (*sql == ' ' || *sql == '\t'); ++sql);
+    return sql < end && *sql == '@';
+}
+
+// Skips whitespace and comments between statements, counting lines. Stops at directives.
+const char *skip_gap(const char *sql, const char *end, int &line) {
+    while(sql < end) {
+        if(*sql == '\n') ++line;
+        if(*sql == ' ' || *sql == '\t' || *sql == '\r' || *sql == '\n') ++sql;
+        else if(is_directive(sql, end)) break;
+        else if(sql+1 < end && sql[0] == '-' && sql[1] == '-') {
+            while(sql < end && *sql != '\n') ++sql;
+        } else if(sql+1 < end && sql[0] == '/' && sql[1] == '*') {
+            sql += 2;
+            while(sql+1 < end && !(sql[0] == '*' && sql[1] == '/')) line += *sql++ == '\n';
+            sql = sql+1 < end ? sql+2 : end;
+        } else break;
+    }
+    return sql;
+}
+
+Script load_sql_script(sqlite3 *db, const char *path) {
+
+    MappedFile file;
+    if(!map_file(path, file)) {
+        fprintf(stderr, "ERROR: failed to open %s\n", path);
+        exit(EXIT_FAILURE);
+    }
+
+    const char *sql = file.data;
+    const char *end = file.data + file.size;
+    int line = 1;
+    Script script;
+
+    struct Block {
+        std::string_view name;
+        size_t start;   // its guard or @repeat, or its first statement when it's dropped
+        int line;
+        bool skipped;   // its guard was false while loading
+        int64_t changes;
+        bool dropped = false;   // its guard failed to compile, so it never runs
+    };
+    // drops the statements of a block from `start` on
+    auto drop = [&](size_t start) {
+        for(size_t i = start; i < script.statements.size(); ++i) sqlite3_finalize(script.statements[i].stmt);
+        script.statements.resize(start);
+    };
+    std::vector<Block> blocks;
+    int skipped = 0;    // enclosing blocks whose guard was false while loading
+    int hot_line = 0;   // of a `-- @hot` waiting for its statement
+    int main_loop_line = 0;
+
+    while(true) {
+        sql = skip_gap(sql, end, line);
+        if(sql >= end) break;
+
+        if(is_directive(sql, end)) {
+            const char *eol = sql;
+            while(eol < end && *eol != '\n') ++eol;
+            std::string_view text(sql, eol - sql);
+            text.remove_prefix(text.find('@') + 1);
+            auto name = text.substr(0, text.find_first_of(" \t\r"));
+            auto args = text.substr(name.size());
+            sql = eol;
+
+            if(name == "if") {
+                auto guard_sql = "select " + std::string(args);
+                sqlite3_stmt *stmt = nullptr;
+                int rc = sqlite3_prepare_v3(db, guard_sql.c_str(), -1, SQLITE_PREPARE_PERSISTENT, &stmt, nullptr);
+                if(rc != SQLITE_OK || !stmt) {
+                    fprintf(stderr, "ERROR COMPILING SQL (%s:%d): %d %s\n", path, line, rc, sqlite3_errmsg(db));
+                    // its statements are compiled as if skipped, then dropped at @endif
+                    blocks.push_back({"if", script.statements.size(), line, true, 0, true});
+                    ++skipped;
+                    hot_line = 0;
+                    continue;
+                }
+                auto params = find_params(db, stmt);
+                bind_params(stmt, params);
+                bool pass = !skipped && guard_passes(db, stmt);
+                blocks.push_back({"if", script.statements.size(), line, !pass, 0});
+                skipped += !pass;
+                script.statements.push_back({stmt, line});
+                script.statements.back().kind = StatementKind::if_guard;
+                script.statements.back().params = std::move(params);
+                script.statements.back().hot = std::exchange(hot_line, 0) != 0;
+            } else if(name == "repeat") {
+                int max_iterations = 64;
+                bool until_unchanged = false, invalid = false;
+                for(size_t pos = 0; pos < args.size();) {
+                    size_t word_end = std::min(args.find_first_of(" \t\r", pos), args.size());
+                    auto word = args.substr(pos, word_end - pos);
+                    pos = word_end + 1;
+                    if(word.empty()) continue;
+                    if(word == "until-unchanged") until_unchanged = true;
+                    else if(word.starts_with("max=")) {
+                        auto [ptr, ec] = std::from_chars(word.data() + 4, word.data() + word.size(), max_iterations);
+                        invalid |= ec != std::errc() || ptr != word.data() + word.size() || max_iterations < 1;
+                    } else invalid = true;
+                }
+                if(!until_unchanged || invalid) {
+                    fprintf(stderr, "ERROR IN SCRIPT (%s:%d): expected @repeat until-unchanged max=N\n", path, line);
+                    max_iterations = 1;
+                }
+                blocks.push_back({"repeat", script.statements.size(), line, false, sqlite3_total_changes64(db)});
+                script.statements.push_back({nullptr, line});
+                script.statements.back().kind = StatementKind::repeat;
+                script.statements.back().max_iterations = max_iterations;
+            } else if(name == "hot") {
+                hot_line = line;
+            } else if(name == "main-loop") {
+                if(main_loop_line) {
+                    fprintf(stderr, "ERROR IN SCRIPT (%s:%d): @main-loop after the one at line %d\n", path, line, main_loop_line);
+                    continue;
+                }
+                main_loop_line = line;
+                for(auto &s : script.statements) s.setup = true;
+            } else if(name == "endif" || name == "endrepeat") {
+                auto opened = name.substr(3);
+                if(blocks.empty() || blocks.back().name != opened) {
+                    fprintf(stderr, "ERROR IN SCRIPT (%s:%d): @%.*s without @%.*s\n", path, line,
+                        (int) name.size(), name.data(), (int) opened.size(), opened.data());
+                    continue;
+                }
+                auto block = blocks.back();
+                blocks.pop_back();
+                skipped -= block.skipped;
+                if(block.dropped) {
+                    drop(block.start);
+                    continue;
+                }
+                script.statements[block.start].block_end = script.statements.size();
+                // the statements ran once as they were compiled
+                if(opened == "repeat" && !skipped)
+                    repeat_block(db, script, block.start, 1, sqlite3_total_changes64(db) - block.changes);
+            } else {
+                fprintf(stderr, "ERROR IN SCRIPT (%s:%d): unknown directive @%.*s\n", path, line, (int) name.size(), name.data());
+            }
+            continue;
+        }
+
+        const char *begin = sql;
+        sqlite3_stmt *stmt;
+        int rc = sqlite3_prepare_v3(db, sql, end-sql, SQLITE_PREPARE_PERSISTENT, &stmt, &sql);
+        int stmt_line = line;
+        for(const char *c = begin; c < sql; ++c) line += *c == '\n';
+
+        if(rc != SQLITE_OK) {
+            fprintf(stderr, "ERROR COMPILING SQL (%s:%d): %d %s\n", path, stmt_line, rc, sqlite3_errmsg(db));
+            if(sql == begin) break;
+            continue;
+        }
+        if(!stmt) continue; // e.g. a lone ';'
+        auto params = find_params(db, stmt);
+        bind_params(stmt, params);
+        // we need to execute each statement before compiling the next one
+        // otherwise SQLite will error due to missing tables
+        if(!skipped) execute_stmt(db, stmt);
+        script.statements.push_back({stmt, stmt_line});
+        script.statements.back().params = std::move(params);
+        script.statements.back().hot = std::exchange(hot_line, 0) != 0;
+    }
+
+    if(hot_line) fprintf(stderr, "ERROR IN SCRIPT (%s:%d): @hot without a statement after it\n", path, hot_line);
+
+    for(auto &block : blocks)
+        fprintf(stderr, "ERROR IN SCRIPT (%s:%d): @%.*s without @end%.*s\n", path, block.line,
+            (int) block.name.size(), block.name.data(), (int) block.name.size(), block.name.data());
+    // innermost first, as dropping a block drops the ones inside it too
+    for(auto &block : std::views::reverse(blocks)) {
+        if(block.dropped) drop(block.start);
+        else script.statements[block.start].block_end = script.statements.size();
+    }
+
+    report_query_plans(db, path, script);
+    return script;
+}
+
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <host_params.h>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+namespace sqhell {
+
+enum class StatementKind {
+    sql,
+    if_guard,   // evaluates the condition of an `-- @if` block
+    repeat,     // starts an `-- @repeat` block, has no statement of its own
+};
+
+struct ScriptStatement {
+    sqlite3_stmt *stmt;
+    int line;           // line in the script where the statement starts
+    uint64_t runs = 0;  // only counted when the script is profiled
+    double seconds = 0;
+    StatementKind kind = StatementKind::sql;
+    size_t block_end = 0;       // for blocks, the first statement after the block
+    int max_iterations = 0;     // for @repeat
+    int last_iterations = 0;    // passes @repeat made over its block the last time it ran
+    uint64_t iterations = 0;    // sum of them, only counted when the script is profiled
+    bool warned = false;        // the block hit max_iterations without converging
+    bool hot = false;           // marked `-- @hot`
+    bool setup = false;         // comes before `-- @main-loop`
+    std::vector<ParamBinding> params;   // host parameters bound before each run
+};
+
+struct Script {
+    std::vector<ScriptStatement> statements;
+    bool profile = false; // measure time spent in each statement
+};
+
+// Compiles the script one statement at a time, executing each one right after it's compiled
+// (so the following statements can refer to the tables it creates).
+//
+// Statements between `-- @if <expression>` and `-- @endif` only run when `select <expression>`
+// returns a true value, otherwise the whole block is skipped without stepping any of them.
+//
+// `-- @repeat until-unchanged max=N` ... `-- @endrepeat` runs its block again and again until a pass
+// changes no rows (by sqlite3_total_changes64(), so updates have to skip rows already in their final
+// state), at most N times (64 by default). Passes are logged at the trace level.
+//
+// Blocks can be nested. A block skipped while loading is still compiled, so it can't use
+// tables that only its own statements create.
+//
+// `-- @hot` marks the statement after it as part of the hot loop. Once the script is loaded,
+// report_query_plans() logs the full scans, temp B-trees and correlated subqueries in it
+// (see query_plans.h), and strict mode fails startup when a @hot statement has any.
+//
+// `-- @main-loop` ends the setup part of the script. The statements before it still run every
+// frame, but are written to do nothing after the first one (`create table if not exists`,
+// inserts guarded by `where not exists`), so the query plan report leaves them out.
+//
+// Statements and guards referring to host parameters (`:dt`, see host_params.h) get their
+// current values bound before every run.
+Script load_sql_script(sqlite3 *db, const char *path);
+
+// Runs the statement to completion, exits on error
+void execute_stmt(sqlite3 *db, sqlite3_stmt *stmt);
+
+// Runs every statement of the script once
+void run_script(sqlite3 *db, Script &script);
+
+}
@@ -0,0 +1,360 @@
+#include <snapshot.h>
+#include <frame.h>
+#include <logger.h>
+#include <vtab.h>
+#include <sqlite3.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+
+namespace sqhell {
+
+// Snapshots kept when only snapshot() captures them
+constexpr size_t DEFAULT_SNAPSHOTS = 300;
+
+// SQLite's default page size. Pages of other sizes work too, they just straddle these.
+constexpr int64_t PAGE_SIZE = 4096;
+
+// Pages are shared between the database file and the snapshots taken of it, and copied when
+// written while a snapshot holds them. So a snapshot costs only the pages the frame wrote to.
+using Page = std::shared_ptr<char[]>;
+
+struct MemoryFile {
+    std::vector<Page> pages;    // null for pages never written
+    int64_t size = 0;
+    size_t written_pages = 0;   // copied or added since the last capture
+};
+
+struct OpenFile : sqlite3_file {
+    std::shared_ptr<MemoryFile> file;
+};
+
+struct Snapshot {
+    uint64_t id;        // frame it was taken at the end of
+    int64_t size;
+    std::vector<Page> pages;
+    size_t new_bytes;
+    double capture_seconds;
+    std::vector<std::pair<SnapshotState*, std::shared_ptr<const void>>> states;
+};
+
+struct SnapshotRing {
+    std::deque<Snapshot> snapshots;
+    bool capture_requested = false;
+    int64_t restore_id = -1;
+    uint64_t captures = 0;
+    uint64_t restores = 0;
+    double capture_seconds = 0, max_capture_seconds = 0;
+};
+
+int rewind_frames = 0;
+SnapshotRing ring;
+
+// Benchmark worlds add and remove their state from their own threads
+std::mutex states_mutex;
+std::vector<SnapshotState*> states;
+
+// Files of the snapshot VFS by name, alive while a connection has them open
+std::mutex files_mutex;
+std::unordered_map<std::string, std::weak_ptr<MemoryFile>> files;
+
+void set_rewind_frames(int frames) { rewind_frames = frames; }
+
+void add_snapshot_state(SnapshotState *state) {
+    std::lock_guard lock(states_mutex);
+    states.push_back(state);
+}
+
+void remove_snapshot_state(SnapshotState *state) {
+    std::lock_guard lock(states_mutex);
+    std::erase(states, state);
+    for(auto &snap : ring.snapshots)
+        std::erase_if(snap.states, [&](auto &saved) { return saved.first == state; });
+}
+
+MemoryFile &memory_file(sqlite3_file *f) {
+    return *static_cast<OpenFile*>(f)->file;
+}
+
+int file_close(sqlite3_file *f) {
+    static_cast<OpenFile*>(f)->~OpenFile();
+    return SQLITE_OK;
+}
+
+int file_read(sqlite3_file *f, void *buf, int amount, sqlite3_int64 offset) {
+    auto &file = memory_file(f);
+    auto out = (char*) buf;
+    int64_t available = std::clamp<int64_t>(file.size - offset, 0, amount);
+    for(int64_t done = 0; done < available;) {
+        int64_t pos = offset + done, index = pos / PAGE_SIZE;
+        int64_t n = std::min(available - done, PAGE_SIZE - pos % PAGE_SIZE);
+        if(index < (int64_t) file.pages.size() && file.pages[index]) memcpy(out + done, file.pages[index].get() + pos % PAGE_SIZE, n);
+        else memset(out + done, 0, n);
+        done += n;
+    }
+    if(available == amount) return SQLITE_OK;
+    memset(out + available, 0, amount - available);
+    return SQLITE_IOERR_SHORT_READ;
+}
+
+// Copies the page first if a snapshot holds it
+char *writable_page(MemoryFile &file, size_t index) {
+    if(index >= file.pages.size()) file.pages.resize(index + 1);
+    auto &page = file.pages[index];
+    if(page && page.use_count() == 1) return page.get();
+    Page copy(new char[PAGE_SIZE]);
+    if(page) memcpy(copy.get(), page.get(), PAGE_SIZE);
+    else memset(copy.get(), 0, PAGE_SIZE);
+    page = std::move(copy);
+    ++file.written_pages;
+    return page.get();
+}
+
+int file_write(sqlite3_file *f, const void *buf, int amount, sqlite3_int64 offset) {
+    auto &file = memory_file(f);
+    auto in = (const char*) buf;
+    for(int64_t done = 0; done < amount;) {
+        int64_t pos = offset + done;
+        int64_t n = std::min(amount - done, PAGE_SIZE - pos % PAGE_SIZE);
+        memcpy(writable_page(file, pos / PAGE_SIZE) + pos % PAGE_SIZE, in + done, n);
+        done += n;
+    }
+    file.size = std::max<int64_t>(file.size, offset + amount);
+    return SQLITE_OK;
+}
+
+int file_truncate(sqlite3_file *f, sqlite3_int64 size) {
+    auto &file = memory_file(f);
+    if(size < file.size) {
+        file.pages.resize((size + PAGE_SIZE - 1) / PAGE_SIZE);
+        file.size = size;
+    }
+    return SQLITE_OK;
+}
+
+int file_sync(sqlite3_file*, int) { return SQLITE_OK; }
+
+int file_size(sqlite3_file *f, sqlite3_int64 *size) {
+    *size = memory_file(f).size;
+    return SQLITE_OK;
+}
+
+// One connection per file, so there is nothing to lock against. The pager still drops its lock
+// after every transaction and checks the change counter when it takes it again, which is how it
+// notices that restore() swapped the pages under its cache.
+int file_lock(sqlite3_file*, int) { return SQLITE_OK; }
+int file_check_reserved_lock(sqlite3_file*, int *reserved) { *reserved = 0; return SQLITE_OK; }
+int file_control(sqlite3_file*, int, void*) { return SQLITE_NOTFOUND; }
+int file_sector_size(sqlite3_file*) { return PAGE_SIZE; }
+int file_device_characteristics(sqlite3_file*) {
+    return SQLITE_IOCAP_SAFE_APPEND | SQLITE_IOCAP_SEQUENTIAL | SQLITE_IOCAP_POWERSAFE_OVERWRITE;
+}
+
+const sqlite3_io_methods io_methods = {
+    1, file_close, file_read, file_write, file_truncate, file_sync, file_size, file_lock, file_lock,
+    file_check_reserved_lock, file_control, file_sector_size, file_device_characteristics,
+};
+
+int vfs_open(sqlite3_vfs*, sqlite3_filename name, sqlite3_file *f, int flags, int *out_flags) {
+    auto open = new (f) OpenFile{};
+    if(name) {
+        std::lock_guard lock(files_mutex);
+        auto &entry = files[name];
+        if(!(open->file = entry.lock())) entry = open->file = std::make_shared<MemoryFile>();
+    } else {
+        open->file = std::make_shared<MemoryFile>();
+    }
+    open->pMethods = &io_methods;
+    if(out_flags) *out_flags = flags;
+    return SQLITE_OK;
+}
+
+int vfs_delete(sqlite3_vfs*, const char *name, int) {
+    std::lock_guard lock(files_mutex);
+    files.erase(name);
+    return SQLITE_OK;
+}
+
+int vfs_access(sqlite3_vfs*, const char *name, int, int *result) {
+    std::lock_guard lock(files_mutex);
+    auto it = files.find(name);
+    *result = it != files.end() && !it->second.expired();
+    return SQLITE_OK;
+}
+
+int vfs_full_pathname(sqlite3_vfs*, const char *name, int size, char *out) {
+    snprintf(out, size, "%s", name);
+    return SQLITE_OK;
+}
+
+// Randomness, time and the rest come from the default VFS
+sqlite3_vfs *register_snapshot_vfs() {
+    static sqlite3_vfs vfs = *sqlite3_vfs_find(nullptr);
+    vfs.iVersion = 2;
+    vfs.szOsFile = sizeof(OpenFile);
+    vfs.pNext = nullptr;
+    vfs.zName = "sqhell_snapshots";
+    vfs.pAppData = nullptr;
+    vfs.xOpen = vfs_open;
+    vfs.xDelete = vfs_delete;
+    vfs.xAccess = vfs_access;
+    vfs.xFullPathname = vfs_full_pathname;
+    sqlite3_vfs_register(&vfs, 0);
+    return &vfs;
+}
+
+int open_snapshot_database(sqlite3 **db) {
+    static sqlite3_vfs *vfs = register_snapshot_vfs();
+    static std::atomic<int> opened = 0;
+    auto name = "sqhell-" + std::to_string(++opened);
+    int rc = sqlite3_open_v2(name.c_str(), db, SQLITE_OPEN_READWRITE|SQLITE_OPEN_CREATE, vfs->zName);
+    // no journal file, and nothing to sync
+    if(rc == SQLITE_OK) rc = sqlite3_exec(*db, "pragma journal_mode = memory; pragma synchronous = off; pragma temp_store = memory",
+        nullptr, nullptr, nullptr);
+    return rc;
+}
+
+MemoryFile *snapshot_file(sqlite3 *db) {
+    sqlite3_file *f = nullptr;
+    if(sqlite3_file_control(db, "main", SQLITE_FCNTL_FILE_POINTER, &f) != SQLITE_OK || !f || f->pMethods != &io_methods)
+        return nullptr;
+    return &memory_file(f);
+}
+
+void capture(sqlite3 *db) {
+    auto begin = std::chrono::steady_clock::now();
+    auto file = snapshot_file(db);
+    if(!file) {
+        log_message(LOG_ERROR, "snapshot(): the database wasn't opened with open_snapshot_database() (sqhell --rewind)");
+        return;
+    }
+    Snapshot snap{current_frame(), file->size, file->pages, std::exchange(file->written_pages, 0) * PAGE_SIZE, 0};
+    {
+        std::lock_guard lock(states_mutex);
+        for(auto state : states)
+            if(state->db == db) snap.states.emplace_back(state, state->save());
+    }
+
+    snap.capture_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    ring.captures++;
+    ring.capture_seconds += snap.capture_seconds;
+    ring.max_capture_seconds = std::max(ring.max_capture_seconds, snap.capture_seconds);
+    ring.snapshots.push_back(std::move(snap));
+
+    size_t keep = rewind_frames > 0 ? rewind_frames : DEFAULT_SNAPSHOTS;
+    while(ring.snapshots.size() > keep) ring.snapshots.pop_front();
+}
+
+Snapshot *find_snapshot(int64_t id) {
+    auto it = std::ranges::lower_bound(ring.snapshots, (uint64_t) id, {}, &Snapshot::id);
+    return it != ring.snapshots.end() && it->id == (uint64_t) id ? &*it : nullptr;
+}
+
+// The pages are swapped under the connection between two transactions. Its pager sees the old
+// change counter when it next reads, drops its cache, and a changed schema cookie makes prepared
+// statements re-prepare, so the schema objects they point at stay valid.
+void restore(sqlite3 *db, int64_t id) {
+    auto snap = find_snapshot(id);
+    auto file = snapshot_file(db);
+    if(!snap || !file) return;
+    file->pages = snap->pages;
+    file->size = snap->size;
+    file->written_pages = 0;
+    {
+        std::lock_guard lock(states_mutex);
+        for(auto &[state, saved] : snap->states) state->load(saved.get());
+    }
+    // later snapshots belong to the timeline we just left
+    while(ring.snapshots.back().id > (uint64_t) id) ring.snapshots.pop_back();
+    ++ring.restores;
+}
+
+uint64_t snapshot_restores() { return ring.restores; }
+
+void snapshot_end_frame(sqlite3 *db) {
+    if(ring.restore_id >= 0) {
+        restore(db, ring.restore_id);
+        ring.restore_id = -1;
+        ring.capture_requested = false;
+        return;
+    }
+    if(ring.capture_requested || rewind_frames > 0) {
+        ring.capture_requested = false;
+        capture(db);
+    }
+}
+
+void report_snapshots() {
+    if(!ring.captures) return;
+    std::unordered_set<const char*> unique;
+    size_t bytes = 0, full_bytes = 0;
+    for(auto &snap : ring.snapshots) {
+        full_bytes += snap.size;
+        for(auto &page : snap.pages)
+            if(page && unique.insert(page.get()).second) bytes += PAGE_SIZE;
+    }
+    log_message(LOG_ALWAYS, "  Snapshots: %zu kept in %.2f MiB (%.2f MiB as full copies), avg capture %.3f ms, max %.3f ms",
+        ring.snapshots.size(), bytes / 1048576.0, full_bytes / 1048576.0,
+        ring.capture_seconds * 1000 / ring.captures, ring.max_capture_seconds * 1000);
+}
+
+void sql_snapshot(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
+    assert(argc == 0);
+    if(!snapshot_file(sqlite3_context_db_handle(ctx))) {
+        sqlite3_result_error(ctx, "snapshot(): the database wasn't opened with open_snapshot_database() (sqhell --rewind)", -1);
+        return;
+    }
+    ring.capture_requested = true;
+    sqlite3_result_int64(ctx, current_frame());
+}
+
+void sql_restore(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
+    assert(argc == 1);
+    int64_t id = sqlite3_value_int64(argv[0]);
+    if(!find_snapshot(id)) {
+        char msg[64];
+        snprintf(msg, sizeof(msg), "restore(): no snapshot with id %lld", (long long) id);
+        sqlite3_result_error(ctx, msg, -1);
+        return;
+    }
+    // the database can't be replaced while statements are running
+    ring.restore_id = id;
+}
+
+struct SnapshotsTable {
+    static constexpr const char *schema = "create table x(id integer, bytes integer, new_bytes integer, capture_us real)";
+
+    static size_t row_count() { return ring.snapshots.size(); }
+
+    static void column(size_t row, sqlite3_context *ctx, int col) {
+        auto &snap = ring.snapshots[row];
+        switch(col) {
+            case 0: sqlite3_result_int64(ctx, snap.id); break;
+            case 1: sqlite3_result_int64(ctx, snap.size); break;
+            case 2: sqlite3_result_int64(ctx, snap.new_bytes); break;
+            case 3: sqlite3_result_double(ctx, snap.capture_seconds * 1e6); break;
+        }
+    }
+};
+
+void create_snapshot_functions(sqlite3 *db) {
+    int rc = sqlite3_create_function(db, "snapshot", 0, SQLITE_UTF8, nullptr, sql_snapshot, nullptr, nullptr);
+    if(rc == SQLITE_OK) rc = sqlite3_create_function(db, "restore", 1, SQLITE_UTF8, nullptr, sql_restore, nullptr, nullptr);
+    if(rc != SQLITE_OK) throw std::runtime_error("failed to create function");
+    create_eponymous_table<SnapshotsTable>(db, "snapshots");
+}
+
+}
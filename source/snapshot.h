@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+struct sqlite3;
+
+namespace sqhell {
+
+// Opens an in-memory database on a VFS whose pages snapshots share copy-on-write: capturing one
+// costs the pages written since the previous capture, and restoring one swaps the pages back.
+// snapshot() only works on databases opened this way.
+int open_snapshot_database(sqlite3 **db);
+
+// Snapshot the database at the end of every frame and keep the last `frames` of them.
+// Without it only frames that call snapshot() are captured.
+void set_rewind_frames(int frames);
+
+// Captures requested snapshots and applies a requested restore.
+// Call between two passes over the script, when no statement is running.
+void snapshot_end_frame(sqlite3 *db);
+
+// Number of restores applied so far, so state kept outside the database can tell it was rewound
+uint64_t snapshot_restores();
+
+// State kept outside the database that has to rewind with it, such as pending timers.
+// save() runs whenever a snapshot of `db` is captured, and load() gets what it returned
+// when that snapshot is restored. Remove the state before destroying it.
+struct SnapshotState {
+    sqlite3 *db;
+    std::function<std::shared_ptr<const void>()> save;
+    std::function<void(const void *saved)> load;
+};
+void add_snapshot_state(SnapshotState *state);
+void remove_snapshot_state(SnapshotState *state);
+
+// Snapshot memory and capture time for the end-of-run report
+void report_snapshots();
+
+// Registers snapshot(), restore(id) and the eponymous snapshots(id, bytes, new_bytes, capture_us) table.
+// There is one set of snapshots per process, for the database passed to snapshot_end_frame().
+void create_snapshot_functions(sqlite3 *db);
+
+}
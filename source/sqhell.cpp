@@ -2,88 +2,174 @@
 #include <GLFW/glfw3.h>
 #include <sqlite3.h>
 #include <sql_bindings.h>
+#include <logger.h>
+#include <script.h>
+#include <update_fusion.h>
+#include <host_params.h>
+#include <auto_analyze.h>
+#include <query_plans.h>
+#include <frame.h>
+#include <gl_debug.h>
+#include <archive.h>
+#include <program_cache.h>
+#include <snapshot.h>
+#include <input_replay.h>
+#include <memory_config.h>
 #include <stdexcept>
 #include <iostream>
 #include <fstream>
 #include <algorithm>
 #include <cctype>
 #include <vector>
+#include <cstring>
+#include <chrono>
+#include <new>
+#include <cstdlib>
 
 namespace rn = std::ranges;
 
-std::vector<sqlite3_stmt*> load_sql_script(sqlite3 *db, const char *path);
-void execute_stmt(sqlite3 *db, sqlite3_stmt *stmt);
-
 int main(int argc, char **argv) {
 
     int rc;
     char *errmsg;
-    const char *db_name = ":memory:";
-    const char *script_path;
+    const char *script_path = nullptr;
+    const char *log_path = nullptr;
+    const char *archive_path = nullptr;
+    const char *record_path = nullptr;
+    const char *replay_path = nullptr;
+    bool fuse_updates = false;
+    bool snapshots = false;
+    sqhell::AutoAnalyze analyze;
+    sqhell::MemoryConfig memory;
+
+    for(int i = 1; i < argc; ++i) {
+        if(strcmp(argv[i], "--log-file") == 0 && i+1 < argc) log_path = argv[++i];
+        else if(strcmp(argv[i], "--archive") == 0 && i+1 < argc) archive_path = argv[++i];
+        else if(strcmp(argv[i], "--shader-cache") == 0 && i+1 < argc) sqhell::set_program_cache_dir(argv[++i]);
+        else if(strcmp(argv[i], "--no-shader-cache") == 0) sqhell::set_program_cache_dir(nullptr);
+        else if(strcmp(argv[i], "--gl-debug") == 0) sqhell::enable_gl_debug();
+        else if(strcmp(argv[i], "--rewind") == 0 && i+1 < argc) {
+            sqhell::set_rewind_frames(atoi(argv[++i]));
+            snapshots = true;
+        }
+        else if(strcmp(argv[i], "--record") == 0 && i+1 < argc) record_path = argv[++i];
+        else if(strcmp(argv[i], "--replay") == 0 && i+1 < argc) replay_path = argv[++i];
+        else if(strcmp(argv[i], "--page-cache") == 0 && i+1 < argc) memory.page_cache_pages = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--slab-page-cache") == 0) memory.slab_page_cache = true;
+        else if(strcmp(argv[i], "--sqlite-heap") == 0 && i+1 < argc) memory.heap_mib = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--frame-times") == 0 && i+1 < argc) sqhell::set_frame_times_path(argv[++i]);
+        else if(strcmp(argv[i], "--fuse-updates") == 0) fuse_updates = true;
+        else if(strcmp(argv[i], "--strict-hot-plans") == 0) sqhell::set_strict_hot_plans(true);
+        else if(strcmp(argv[i], "--auto-analyze") == 0 && i+1 < argc) analyze.interval = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--log-level") == 0 && i+1 < argc) {
+            int level = sqhell::parse_log_level(argv[++i]);
+            if(level < 0) {
+                fprintf(stderr, "Unknown log level: %s\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+            sqhell::set_log_level(level);
+        }
+        else script_path = argv[i];
+    }
 
-    if(argc <= 1) {
-        fprintf(stderr, "Usage: %s <sql file>\n", *argv);
+    if(!script_path) {
+        fprintf(stderr, "Usage: %s [--archive <path>] [--shader-cache <dir>] [--no-shader-cache] [--gl-debug] [--rewind <frames>] [--record <path> | --replay <path>] [--frame-times <csv>] [--slab-page-cache] [--page-cache <pages>] [--sqlite-heap <MiB>] [--fuse-updates] [--auto-analyze <frames>] [--strict-hot-plans] [--log-file <path>] [--log-level <level>] <sql file>\n", *argv);
+        return EXIT_FAILURE;
+    }
+
+    sqhell::configure_sqlite_memory(memory);
+    sqhell::start_logger(log_path);
+    std::atexit(sqhell::print_run_report);
+
+    if(archive_path && !sqhell::mount_archive(archive_path)) {
+        fprintf(stderr, "Failed to mount asset archive %s\n", archive_path);
         return EXIT_FAILURE;
     }
-    script_path = argv[1];
     
+    if(record_path && !sqhell::start_input_recording(record_path)) {
+        fprintf(stderr, "Failed to create input recording %s\n", record_path);
+        return EXIT_FAILURE;
+    }
+    if(replay_path && !sqhell::start_input_replay(replay_path)) {
+        fprintf(stderr, "Failed to open input recording %s\n", replay_path);
+        return EXIT_FAILURE;
+    }
+
     sqlite3 *db;
-    rc = sqlite3_open_v2(db_name, &db, SQLITE_OPEN_READWRITE|SQLITE_OPEN_CREATE, nullptr);
+    if(snapshots) rc = sqhell::open_snapshot_database(&db);
+    else rc = sqlite3_open_v2(":memory:", &db, SQLITE_OPEN_READWRITE|SQLITE_OPEN_CREATE, nullptr);
     if(rc != 0) throw std::runtime_error("Failed to open database");
+    sqhell::configure_connection_memory(db, memory);
 
     sqhell::init_sql_bindings(db);
 
-    auto script = load_sql_script(db, script_path);
+    // GLFW isn't initialized before the script runs, the first frame gets a nominal duration
+    double frame_start = 0;
+    sqhell::set_frame_params(db, frame_start, 1.0/60, sqhell::current_frame());
 
-    while(true)
-    for(auto stmt : script)
-    execute_stmt(db, stmt);
-}
+    auto startup_begin = std::chrono::steady_clock::now();
+    auto script = sqhell::load_sql_script(db, script_path);
+    if(fuse_updates) sqhell::fuse_updates(db, script);
+    auto startup_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startup_begin).count();
+
+    auto programs = sqhell::get_program_cache_stats();
+    sqhell::log_message(sqhell::LOG_INFO, "Startup took %.1f ms, %.1f ms of it building shader programs (%d from cache, %d compiled)",
+        startup_ms, programs.seconds*1000, programs.hits, programs.misses);
+    sqhell::snapshot_end_frame(db);
+    sqhell::input_replay_end_frame(db);
+    sqhell::end_frame();
 
-void execute_stmt(sqlite3 *db, sqlite3_stmt *stmt) {
-    //fprintf(stderr, "EXECUTING: %s\n", sqlite3_sql(stmt));
     while(true) {
-        int rc = sqlite3_step(stmt);
-        if(rc == SQLITE_ROW) continue;
-        if(rc == SQLITE_DONE) {
-            sqlite3_reset(stmt);
-            break;
-        }
-        fprintf(stderr, "ERROR: %d %s\n", rc, sqlite3_errmsg(db));
-        exit(EXIT_FAILURE);
+        double now = sqhell::input_time();
+        sqhell::set_frame_params(db, now, now - frame_start, sqhell::current_frame());
+        frame_start = now;
+        sqhell::run_script(db, script);
+
+        sqhell::auto_analyze_end_frame(db, script, analyze);
+        sqhell::snapshot_end_frame(db);
+        sqhell::input_replay_end_frame(db);
+        sqhell::end_frame();
     }
 }
 
-std::vector<sqlite3_stmt*> load_sql_script(sqlite3 *db, const char *path) {
-    
-    std::ifstream fin(path);
-
-    fin.seekg(0, std::ios::end);
-    auto length = fin.tellg();
-    char *script = new char[((size_t)length)+1];
-
-    fin.seekg(0, std::ios::beg);
-    fin.read(script, length);
-    script[length] = '\0';
-
-    fin.close();
-
-    const char *sql = script;
-    std::vector<sqlite3_stmt*> stmts;
-    while(sql < script+length) {
-        sqlite3_stmt *stmt;
-        int rc = sqlite3_prepare_v3(db, sql, -1, SQLITE_PREPARE_PERSISTENT, &stmt, &sql);
-        if(sql == script+length) break; //skip last (empty) statement
-        if(rc == SQLITE_OK) {
-            // we need to execute each statement before compiling the next one
-            // otherwise SQLite will error due to missing tables
-            execute_stmt(db, stmt);
-            stmts.push_back(stmt);
-        } else {
-            fprintf(stderr, "ERROR COMPILING SQL: %d %s", rc, sqlite3_errmsg(db));
-        }
-    }
+// Counts C++ allocations too, the default operator new would call malloc() the same way.
+// Only the executable replaces it, so the library doesn't impose it on the benchmarks.
+
+void *operator new(size_t size, const std::nothrow_t&) noexcept {
+    sqhell::count_heap_allocation();
+    return malloc(size ? size : 1);
+}
+
+void *operator new(size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {
+    sqhell::count_heap_allocation();
+    size_t alignment = std::max(sizeof(void*), (size_t) align);
+    return aligned_alloc(alignment, (std::max<size_t>(size, 1) + alignment - 1) & ~(alignment - 1));
+}
+
+void *operator new(size_t size) {
+    if(void *ptr = operator new(size, std::nothrow)) return ptr;
+    throw std::bad_alloc();
+}
+
+void *operator new(size_t size, std::align_val_t align) {
+    if(void *ptr = operator new(size, align, std::nothrow)) return ptr;
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+void *operator new[](size_t size, std::align_val_t align) { return operator new(size, align); }
+void *operator new[](size_t size, const std::nothrow_t&) noexcept { return operator new(size, std::nothrow); }
+void *operator new[](size_t size, std::align_val_t align, const std::nothrow_t&) noexcept { return operator new(size, align, std::nothrow); }
 
-    delete[] script;
-    return stmts;
-}
\ No newline at end of file
+void operator delete(void *ptr) noexcept { free(ptr); }
+void operator delete[](void *ptr) noexcept { free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { free(ptr); }
+void operator delete(void *ptr, std::align_val_t) noexcept { free(ptr); }
+void operator delete[](void *ptr, std::align_val_t) noexcept { free(ptr); }
+void operator delete(void *ptr, size_t, std::align_val_t) noexcept { free(ptr); }
+void operator delete[](void *ptr, size_t, std::align_val_t) noexcept { free(ptr); }
+void operator delete(void *ptr, const std::nothrow_t&) noexcept { free(ptr); }
+void operator delete[](void *ptr, const std::nothrow_t&) noexcept { free(ptr); }
+void operator delete(void *ptr, std::align_val_t, const std::nothrow_t&) noexcept { free(ptr); }
+void operator delete[](void *ptr, std::align_val_t, const std::nothrow_t&) noexcept { free(ptr); }
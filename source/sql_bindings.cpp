@@ -1,4 +1,18 @@
-#include <util.h>
+#include <logger.h>
+#include <file_cache.h>
+#include <async_loader.h>
+#include <frame_table.h>
+#include <entity_pool.h>
+#include <aggregates.h>
+#include <timers.h>
+#include <host_params.h>
+#include <program_cache.h>
+#include <gl_debug.h>
+#include <gpu_timer.h>
+#include <snapshot.h>
+#include <input_replay.h>
+#include <memory_config.h>
+#include <arena.h>
 #include <sqlite3.h>
 #include <stdexcept>
 #include <glad/glad.h>
@@ -6,52 +20,224 @@
 #include <imgui/imgui.h>
 #include <imgui/imgui_impl_glfw.h>
 #include <imgui/imgui_impl_opengl3.h>
+#include <algorithm>
 #include <cassert>
 #include <vector>
 #include <cstring>
+#include <string>
 
 namespace sqhell {
 
-std::vector<float> floatStack;
+// Everything the bindings keep between calls, one per connection,
+// so independent databases can run on different threads
+struct BindingState {
+    std::vector<float> floatStack;
+    std::vector<float> drawList;    // triangles of x, y, r, g, b, a vertices
+    std::string eval_buf;
+    FrameArena scratch;     // strings returned to SQL, valid until the end of the frame
+    uint64_t rng_state = 0x9e3779b97f4a7c15ull;
+    std::string input_label;        // of ImGuiInputTextMultiline()
+    std::vector<char> input_text;   // its edit buffer, allocated on first use
+};
+
+BindingState &binding_state(sqlite3_context *ctx) {
+    return *(BindingState*) sqlite3_user_data(ctx);
+}
 
 void sql_print(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
-    for(int i=0; i<argc; ++i)
-        printf("%s", sqlite3_value_text(argv[i]));
+    log_values(LOG_ALWAYS, false, argc, argv);
 }
 void sql_println(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
-    sql_print(ctx, argc, argv);
-    puts("");
+    log_values(LOG_ALWAYS, true, argc, argv);
+}
+
+// Accepts either a level name ('debug', 'warn', ...) or its number
+int log_level_arg(sqlite3_value *arg) {
+    if(sqlite3_value_type(arg) == SQLITE_INTEGER) return sqlite3_value_int(arg);
+    return parse_log_level((const char*) sqlite3_value_text(arg));
+}
+
+// Not named log(), which would replace SQLite's logarithm
+void sql_logMessage(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
+    if(argc < 2) {
+        sqlite3_result_error(ctx, "logMessage(): expected a level and at least one value", -1);
+        return;
+    }
+    int level = log_level_arg(argv[0]);
+    if(level < 0 || level >= LOG_ALWAYS) {
+        sqlite3_result_error(ctx, "logMessage(): invalid log level", -1);
+        return;
+    }
+    log_values(level, true, argc-1, argv+1);
 }
+
+void sql_setLogLevel(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
+    assert(argc == 1);
+    int level = log_level_arg(argv[0]);
+    if(level < 0 || level > LOG_ALWAYS) {
+        sqlite3_result_error(ctx, "setLogLevel(): invalid log level", -1);
+        return;
+    }
+    set_log_level(level);
+}
+
+void sql_logDropped(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
+    assert(argc == 0);
+    sqlite3_result_int64(ctx, get_log_stats().dropped);
+}
+
 void sql_exit(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
     assert(argc <= 1);
     int exit_code = argc == 0 ? 0 : sqlite3_value_int(argv[0]);
     std::exit(exit_code);
 }
 
+// Results point straight into the cached mapping, so SQLite must not free them.
+// Don't truncate the file in place while the script reads it (see map_file()).
 void sql_read_file_text(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
     assert(argc == 1);
     auto path = (const char*) sqlite3_value_text(argv[0]);
-    sqlite3_result_text(ctx, read_text(path), -1, free);
+    MappedFile file;
+    if(!path || !map_file(path, file)) {
+        sqlite3_result_error(ctx, "readFileText(): failed to open file", -1);
+        return;
+    }
+    sqlite3_result_text(ctx, file.data, file.size, SQLITE_STATIC);
+}
+
+void sql_read_file_blob(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
+    assert(argc == 1);
+    auto path = (const char*) sqlite3_value_text(argv[0]);
+    MappedFile file;
+    if(!path || !map_file(path, file)) {
+        sqlite3_result_error(ctx, "readFileBlob(): failed to open file", -1);
+        return;
+    }
+    sqlite3_result_blob(ctx, file.data, file.size, SQLITE_STATIC);
+}
+
+// Finished loads show up in the completed_loads table on the next frame
+void sql_loadAsync(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
+    assert(argc == 1);
+    auto path = (const char*) sqlite3_value_text(argv[0]);
+    if(!path) {
+        sqlite3_result_error(ctx, "loadAsync(): path is null", -1);
+        return;
+    }
+    sqlite3_result_int64(ctx, load_async(path));
+}
+
+void sql_invalidateFileCache(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
+    assert(argc == 0 || argc == 1);
+    invalidate_file_cache(argc == 0 ? nullptr : (const char*) sqlite3_value_text(argv[0]));
+}
+
+void sql_fileCacheHits(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
+    assert(argc == 0);
+    sqlite3_result_int64(ctx, get_file_cache_stats().hits);
+}
+
+void sql_fileCacheMisses(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
+    assert(argc == 0);
+    sqlite3_result_int64(ctx, get_file_cache_stats().misses);
+}
+
+// Deterministic alternative to random(), so benchmarks and replays can be reproduced
+uint64_t next_random(uint64_t &rng_state) {
+    // splitmix64
+    uint64_t z = (rng_state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+void sql_seedRandom(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
+    assert(argc == 1);
+    binding_state(ctx).rng_state = sqlite3_value_int64(argv[0]);
+}
+
+void sql_randomFloat(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
+    assert(argc == 0 || argc == 2);
+    double r = (next_random(binding_state(ctx).rng_state) >> 11) * 0x1.0p-53;
+    if(argc == 2) {
+        double lo = sqlite3_value_double(argv[0]);
+        double hi = sqlite3_value_double(argv[1]);
+        r = lo + r * (hi - lo);
+    }
+    sqlite3_result_double(ctx, r);
 }
 
 void sql_push_floats(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
+    auto &floatStack = binding_state(ctx).floatStack;
     for(int i=0; i<argc; ++i)
         floatStack.push_back(sqlite3_value_double(argv[i]));
 }
 
 void sql_clear_floats(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
     assert(argc == 0);
-    floatStack.clear();
+    binding_state(ctx).floatStack.clear();
 }
 
 void sql_get_floats(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
     assert(argc == 0);
-    sqlite3_result_int64(ctx, (int64_t) floatStack.data());
+    sqlite3_result_int64(ctx, (int64_t) binding_state(ctx).floatStack.data());
+}
+
+void emit_vertex(std::vector<float> &out, float x, float y, const float *color) {
+    out.insert(out.end(), {x, y, color[0], color[1], color[2], color[3]});
+}
+
+// emitRect(x, y, sx, sy, r, g, b, a), centered on x, y
+void sql_emitRect(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
+    assert(argc == 8);
+    float v[8];
+    for(int i = 0; i < 8; ++i) v[i] = sqlite3_value_double(argv[i]);
+    float x0 = v[0] - v[2]/2, x1 = v[0] + v[2]/2;
+    float y0 = v[1] - v[3]/2, y1 = v[1] + v[3]/2;
+    auto &out = binding_state(ctx).drawList;
+    emit_vertex(out, x0, y0, v+4);
+    emit_vertex(out, x1, y0, v+4);
+    emit_vertex(out, x0, y1, v+4);
+    emit_vertex(out, x1, y0, v+4);
+    emit_vertex(out, x0, y1, v+4);
+    emit_vertex(out, x1, y1, v+4);
+}
+
+// emitQuad(x0, y0, x1, y1, x2, y2, x3, y3, r, g, b, a), corners in order around the quad
+void sql_emitQuad(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
+    assert(argc == 12);
+    float v[12];
+    for(int i = 0; i < 12; ++i) v[i] = sqlite3_value_double(argv[i]);
+    auto &out = binding_state(ctx).drawList;
+    emit_vertex(out, v[0], v[1], v+8);
+    emit_vertex(out, v[2], v[3], v+8);
+    emit_vertex(out, v[4], v[5], v+8);
+    emit_vertex(out, v[0], v[1], v+8);
+    emit_vertex(out, v[4], v[5], v+8);
+    emit_vertex(out, v[6], v[7], v+8);
+}
+
+// Uploads everything emitted since the last flush to the buffer and draws it with the
+// bound program and vertex array. Returns the number of vertices drawn.
+void sql_flushDrawList(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
+    assert(argc == 1);
+    auto &drawList = binding_state(ctx).drawList;
+    GLsizei vertices = drawList.size() / 6;
+    if(vertices) {
+        glNamedBufferData(sqlite3_value_int(argv[0]), drawList.size() * sizeof(float), drawList.data(), GL_STREAM_DRAW);
+        glDrawArrays(GL_TRIANGLES, 0, vertices);
+    }
+    drawList.clear();
+    sqlite3_result_int(ctx, vertices);
 }
 
-std::string eval_buf;
+void sql_clearDrawList(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
+    assert(argc == 0);
+    binding_state(ctx).drawList.clear();
+}
 
 int sql_eval_callback(void *userPtr, int nCol, char **colValues, char **colNames) {
+    auto &eval_buf = ((BindingState*) userPtr)->eval_buf;
     if(!eval_buf.empty()) eval_buf += "\n";
     for(int i = 0; i < nCol; ++i) {
         eval_buf += colNames[i];
@@ -64,17 +250,20 @@ int sql_eval_callback(void *userPtr, int nCol, char **colValues, char **colNames
 
 void sql_eval(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
     assert(argc == 1);
-    char *cmd = strdup((const char*)sqlite3_value_text(*argv));
+    auto &state = binding_state(ctx);
+    char *cmd = state.scratch.copy((const char*)sqlite3_value_text(*argv), sqlite3_value_bytes(*argv));
     auto db = sqlite3_context_db_handle(ctx);
 
-    eval_buf.clear();
+    state.eval_buf.clear();
     char *err;
-    int rc = sqlite3_exec(db, cmd, sql_eval_callback, nullptr, &err);
-
-    if(rc == SQLITE_OK) sqlite3_result_text(ctx, strdup(eval_buf.c_str()), -1, free);
-    else sqlite3_result_text(ctx, strdup(err), -1, free);
+    int rc = sqlite3_exec(db, cmd, sql_eval_callback, &state, &err);
 
-    free(cmd);
+    if(rc == SQLITE_OK) {
+        sqlite3_result_text(ctx, state.scratch.copy(state.eval_buf.data(), state.eval_buf.size()), -1, SQLITE_STATIC);
+    } else {
+        sqlite3_result_text(ctx, state.scratch.copy(err, strlen(err)), -1, SQLITE_STATIC);
+        sqlite3_free(err);
+    }
 }
 
 void sql_glfwInit(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
@@ -92,6 +281,7 @@ void sql_glfwCreateWindow(sqlite3_context *ctx, int argc, sqlite3_value **argv)
     int width = sqlite3_value_int(argv[0]);
     int height = sqlite3_value_int(argv[1]);
     const unsigned char *title = sqlite3_value_text(argv[2]);
+    if(gl_debug_enabled()) glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GLFW_TRUE);
     sqlite3_result_int64(ctx, (int64_t) glfwCreateWindow(width, height, (const char*)title, nullptr, nullptr));
 }
 
@@ -107,7 +297,7 @@ void sql_glfwGetKey(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
     int key;
     if(type == SQLITE_INTEGER) key = sqlite3_value_int(argv[1]);
     else key = sqlite3_value_text(argv[1])[0];
-    sqlite3_result_int(ctx, glfwGetKey(window, key));
+    sqlite3_result_int(ctx, input_key(window, key));
 }
 
 void sql_glfwSwapBuffers(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
@@ -127,18 +317,20 @@ void sql_glfwMakeContextCurrent(sqlite3_context *ctx, int argc, sqlite3_value **
 
 void sql_glfwWindowShouldClose(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
     assert(argc == 1);
-    int result = glfwWindowShouldClose((GLFWwindow*)sqlite3_value_int64(argv[0]));
+    int result = input_window_should_close((GLFWwindow*)sqlite3_value_int64(argv[0]));
     sqlite3_result_int(ctx, result);
 }
 
 void sql_glfwGetTime(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
     assert(argc == 0);
-    sqlite3_result_double(ctx, glfwGetTime());
+    sqlite3_result_double(ctx, input_time());
 }
 
 void sql_gladLoadGL(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
     assert(argc == 0);
-    sqlite3_result_int(ctx, gladLoadGL());
+    int ret = gladLoadGL();
+    if(ret && gl_debug_enabled()) install_gl_debug_callback();
+    sqlite3_result_int(ctx, ret);
 }
 
 void sql_glClearColor(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
@@ -189,6 +381,21 @@ void sql_glLinkProgram(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
     glLinkProgram(sqlite3_value_int(argv[0]));
 }
 
+// Compiles and links a vertex+fragment program, or loads it from the program binary cache
+void sql_buildProgram(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
+    assert(argc == 2);
+    auto vertexSrc = (const char*) sqlite3_value_text(argv[0]);
+    auto fragmentSrc = (const char*) sqlite3_value_text(argv[1]);
+    if(!vertexSrc || !fragmentSrc) {
+        sqlite3_result_error(ctx, "buildProgram(): shader source is null", -1);
+        return;
+    }
+    std::string error;
+    GLuint program = build_program(vertexSrc, fragmentSrc, error);
+    if(program) sqlite3_result_int(ctx, program);
+    else sqlite3_result_error(ctx, ("buildProgram(): " + error).c_str(), -1);
+}
+
 void sql_glUseProgram(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
     assert(argc == 1);
     glUseProgram(sqlite3_value_int(argv[0]));
@@ -259,6 +466,17 @@ void sql_glDrawArrays(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
     );
 }
 
+void sql_gpuTimerBegin(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
+    assert(argc == 1);
+    auto name = (const char*) sqlite3_value_text(argv[0]);
+    if(auto err = gpu_timer_begin(name ? name : "")) sqlite3_result_error(ctx, err, -1);
+}
+
+void sql_gpuTimerEnd(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
+    assert(argc == 0);
+    if(auto err = gpu_timer_end()) sqlite3_result_error(ctx, err, -1);
+}
+
 void sql_ImGuiCreateContext(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
     assert(argc == 0);
     sqlite3_result_int64(ctx, (int64_t) ImGui::CreateContext());
@@ -325,10 +543,10 @@ void sql_ImGuiEnd(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
 
 void sql_ImGuiLabel(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
     assert(argc == 2);
-    char *name = strdup((const char*)sqlite3_value_text(argv[0]));
+    // converting argv[1] leaves argv[0]'s text alone, so the name needs no copy
+    const char *name = (const char*) sqlite3_value_text(argv[0]);
     const char *value = (const char*) sqlite3_value_text(argv[1]);
     ImGui::LabelText(name, "%s", value);
-    free(name);
 }
 
 void sql_ImGuiButton(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
@@ -343,23 +561,45 @@ void sql_ImGuiButton(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
 void sql_ImGuiInputTextMultiline(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
     assert(argc == 2 || argc == 3);
 
-    static char lblBuf[1<<10];
-    static char txtBuf[1<<20];
-
-    strcpy(lblBuf, (const char*) sqlite3_value_text(argv[0]));
-    strcpy(txtBuf, (const char*) sqlite3_value_text(argv[1]));
+    auto &state = binding_state(ctx);
+    auto &text = state.input_text;
+    if(text.empty()) text.resize(1<<20);
+
+    // null label or text are empty, text longer than the buffer is cut
+    auto label = (const char*) sqlite3_value_text(argv[0]);
+    state.input_label.assign(label ? label : "");
+    auto value = (const char*) sqlite3_value_text(argv[1]);
+    size_t length = value ? std::min<size_t>(sqlite3_value_bytes(argv[1]), text.size() - 1) : 0;
+    memcpy(text.data(), value ? value : "", length);
+    text[length] = '\0';
     int flags = argc < 3 ? 0 : sqlite3_value_int(argv[2]);
-    
-    ImGui::InputTextMultiline(lblBuf, txtBuf, sizeof(txtBuf)-1, ImVec2(0,0), flags);
 
-    sqlite3_result_text(ctx, strdup(txtBuf), -1, free);
+    ImGui::InputTextMultiline(state.input_label.c_str(), text.data(), text.size(), ImVec2(0,0), flags);
+
+    sqlite3_result_text(ctx, state.scratch.copy(text.data(), strlen(text.data())), -1, SQLITE_STATIC);
 }
 
-void create_scalar_function(sqlite3 *db, const char *function_name, int narg, void (*ptr)(sqlite3_context*, int, sqlite3_value**)) {
-    int rc = sqlite3_create_function(db, function_name, narg, SQLITE_UTF8, nullptr, ptr, nullptr, nullptr);
+void sql_heapAllocations(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
+    assert(argc == 0);
+    sqlite3_result_int64(ctx, last_frame_heap_allocations());
+}
+
+void create_scalar_function(sqlite3 *db, const char *function_name, int narg, void (*ptr)(sqlite3_context*, int, sqlite3_value**), void *user = nullptr) {
+    int rc = sqlite3_create_function(db, function_name, narg, SQLITE_UTF8, user, ptr, nullptr, nullptr);
     if(rc != SQLITE_OK) throw std::runtime_error("failed to create function");
 }
 
+void sql_noop(sqlite3_context *ctx, int argc, sqlite3_value **argv) {}
+
+// The state is owned by a hidden function, SQLite destroys it together with the connection
+BindingState *create_binding_state(sqlite3 *db) {
+    auto state = new BindingState();
+    int rc = sqlite3_create_function_v2(db, "sqhell_binding_state", 0, SQLITE_UTF8, state, sql_noop, nullptr, nullptr,
+        [](void *p) { delete (BindingState*) p; });
+    if(rc != SQLITE_OK) throw std::runtime_error("failed to create function");
+    return state;
+}
+
 template<int64_t value>
 void sql_int_constant(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
     sqlite3_result_int64(ctx, value);
@@ -372,15 +612,40 @@ void create_int_constant(sqlite3 *db, const char *name) {
 
 void init_sql_bindings(sqlite3 *db) {
 
+    auto state = create_binding_state(db);
+
     create_scalar_function(db, "print",                    -1, sql_print);
     create_scalar_function(db, "println",                  -1, sql_println);
+    create_scalar_function(db, "logMessage",               -1, sql_logMessage);
+    create_scalar_function(db, "setLogLevel",               1, sql_setLogLevel);
+    create_scalar_function(db, "logDropped",                0, sql_logDropped);
     create_scalar_function(db, "exit",                      0, sql_exit);
     create_scalar_function(db, "exit",                      1, sql_exit);
     create_scalar_function(db, "readFileText",              1, sql_read_file_text);
-    create_scalar_function(db, "pushFloats",               -1, sql_push_floats);
-    create_scalar_function(db, "clearFloats",               0, sql_clear_floats);
-    create_scalar_function(db, "getFloats",                 0, sql_get_floats);
-    create_scalar_function(db, "eval",                      1, sql_eval);
+    create_scalar_function(db, "readFileBlob",              1, sql_read_file_blob);
+    create_scalar_function(db, "loadAsync",                 1, sql_loadAsync);
+    create_completed_loads_module(db);
+    create_frame_table_module(db);
+    create_entity_pool_functions(db);
+    create_aggregate_functions(db);
+    create_timer_functions(db);
+    create_param_functions(db);
+    create_scalar_function(db, "invalidateFileCache",       0, sql_invalidateFileCache);
+    create_scalar_function(db, "invalidateFileCache",       1, sql_invalidateFileCache);
+    create_scalar_function(db, "fileCacheHits",             0, sql_fileCacheHits);
+    create_scalar_function(db, "fileCacheMisses",           0, sql_fileCacheMisses);
+    create_scalar_function(db, "heapAllocations",           0, sql_heapAllocations);
+    create_scalar_function(db, "seedRandom",                1, sql_seedRandom, state);
+    create_scalar_function(db, "randomFloat",               0, sql_randomFloat, state);
+    create_scalar_function(db, "randomFloat",               2, sql_randomFloat, state);
+    create_scalar_function(db, "pushFloats",               -1, sql_push_floats, state);
+    create_scalar_function(db, "clearFloats",               0, sql_clear_floats, state);
+    create_scalar_function(db, "getFloats",                 0, sql_get_floats, state);
+    create_scalar_function(db, "emitRect",                  8, sql_emitRect, state);
+    create_scalar_function(db, "emitQuad",                 12, sql_emitQuad, state);
+    create_scalar_function(db, "flushDrawList",             1, sql_flushDrawList, state);
+    create_scalar_function(db, "clearDrawList",             0, sql_clearDrawList, state);
+    create_scalar_function(db, "eval",                      1, sql_eval, state);
 
     create_scalar_function(db, "glfwInit",                  0, sql_glfwInit);
     create_scalar_function(db, "glfwTerminate",             0, sql_glfwTerminate);
@@ -395,6 +660,7 @@ void init_sql_bindings(sqlite3 *db) {
     create_scalar_function(db, "glfwGetTime",               0, sql_glfwGetTime);
 
     create_scalar_function(db, "gladLoadGL",                0, sql_gladLoadGL);
+    create_gl_debug_log_module(db);
 
     create_scalar_function(db, "glClearColor",              3, sql_glClearColor);
     create_scalar_function(db, "glClearColor",              4, sql_glClearColor);
@@ -408,6 +674,7 @@ void init_sql_bindings(sqlite3 *db) {
     create_scalar_function(db, "glCreateProgram",           0, sql_glCreateProgram);
     create_scalar_function(db, "glAttachShader",            2, sql_glAttachShader);
     create_scalar_function(db, "glLinkProgram",             1, sql_glLinkProgram);
+    create_scalar_function(db, "buildProgram",              2, sql_buildProgram);
     create_scalar_function(db, "glUseProgram",              1, sql_glUseProgram);
     create_scalar_function(db, "glCreateBuffer",            0, sql_glCreateBuffer);
     create_scalar_function(db, "glBindBuffer",              2, sql_glBindBuffer);
@@ -422,6 +689,10 @@ void init_sql_bindings(sqlite3 *db) {
     create_int_constant<GL_FLOAT>(db, "GL_FLOAT");
     create_scalar_function(db, "glDrawArrays",              3, sql_glDrawArrays);
     create_int_constant<GL_TRIANGLES>(db, "GL_TRIANGLES");
+    create_scalar_function(db, "gpuTimerBegin",             1, sql_gpuTimerBegin);
+    create_scalar_function(db, "gpuTimerEnd",               0, sql_gpuTimerEnd);
+    create_gpu_timings_module(db);
+    create_snapshot_functions(db);
 
     create_scalar_function(db, "ImGuiCreateContext",        0, sql_ImGuiCreateContext);
     create_scalar_function(db, "ImGui_ImplGlfw_InitForOpenGL", 2, sql_ImGui_ImplGlfw_InitForOpenGL);
@@ -440,8 +711,8 @@ void init_sql_bindings(sqlite3 *db) {
     create_scalar_function(db, "ImGuiButton",               1, sql_ImGuiButton);
     create_scalar_function(db, "ImGuiButton",               2, sql_ImGuiButton);
     create_scalar_function(db, "ImGuiButton",               3, sql_ImGuiButton);
-    create_scalar_function(db, "ImGuiInputTextMultiline",   2, sql_ImGuiInputTextMultiline);
-    create_scalar_function(db, "ImGuiInputTextMultiline",   3, sql_ImGuiInputTextMultiline);
+    create_scalar_function(db, "ImGuiInputTextMultiline",   2, sql_ImGuiInputTextMultiline, state);
+    create_scalar_function(db, "ImGuiInputTextMultiline",   3, sql_ImGuiInputTextMultiline, state);
 }
 
 }
\ No newline at end of file
@@ -0,0 +1,391 @@
+#include <timers.h>
+#include <snapshot.h>
+#include <sqlite3.h>
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <cassert>
+#include <cstdint>
+
+namespace sqhell {
+
+constexpr double TICK = 0.001; // seconds
+
+// The first level has a slot per tick, every next one a slot per revolution of the previous
+// one. Timers further out than the last level reaches wait in its furthest slot.
+constexpr int ROOT_BITS = 8, LEVEL_BITS = 6, LEVELS = 4;
+constexpr uint64_t ROOT_SLOTS = 1 << ROOT_BITS, LEVEL_SLOTS = 1 << LEVEL_BITS;
+constexpr uint64_t MAX_DELTA = 1ull << (ROOT_BITS + (LEVELS - 1) * LEVEL_BITS);
+constexpr uint32_t NONE = UINT32_MAX;
+
+struct Timer {
+    int64_t entity;
+    double fires_at;
+    uint64_t tick;
+    uint32_t prev, next;    // in the slot's list
+    uint32_t slot;          // NONE when the timer is free
+    int kind;
+};
+
+struct TimerKey {
+    int64_t entity;
+    int kind;
+
+    bool operator==(const TimerKey &) const = default;
+};
+
+struct TimerKeyHash {
+    size_t operator()(const TimerKey &key) const { return std::hash<int64_t>()(key.entity * 64 + key.kind); }
+};
+
+struct FiredTimer {
+    int64_t entity;
+    int kind;
+    double fires_at;
+};
+
+struct SavedTimers {
+    double now;
+    uint64_t next_tick;
+    std::vector<FiredTimer> pending, fired;
+};
+
+struct TimerWheel {
+    std::vector<Timer> timers;
+    std::vector<uint32_t> free_timers;
+    std::vector<uint32_t> slots = std::vector<uint32_t>(ROOT_SLOTS + (LEVELS - 1) * LEVEL_SLOTS, NONE);
+    std::unordered_map<TimerKey, uint32_t, TimerKeyHash> index;
+    std::vector<std::string> kinds;
+    std::vector<FiredTimer> fired;
+    double now = 0;
+    uint64_t next_tick = 0;     // first tick the next advance processes
+    SnapshotState snapshot_state;
+};
+
+int find_kind(const TimerWheel &wheel, std::string_view kind) {
+    auto it = std::ranges::find(wheel.kinds, kind);
+    return it != wheel.kinds.end() ? int(it - wheel.kinds.begin()) : -1;
+}
+
+int intern_kind(TimerWheel &wheel, std::string_view kind) {
+    int found = find_kind(wheel, kind);
+    if(found >= 0) return found;
+    wheel.kinds.emplace_back(kind);
+    return int(wheel.kinds.size() - 1);
+}
+
+uint32_t slot_for(const TimerWheel &wheel, uint64_t tick) {
+    uint64_t delta = tick - wheel.next_tick;
+    if(delta < ROOT_SLOTS) return tick % ROOT_SLOTS;
+    if(delta >= MAX_DELTA) tick = wheel.next_tick + MAX_DELTA - 1;
+    for(int level = 1;; ++level) {
+        int shift = ROOT_BITS + (level - 1) * LEVEL_BITS;
+        if(level == LEVELS - 1 || delta < 1ull << (shift + LEVEL_BITS))
+            return ROOT_SLOTS + (level - 1) * LEVEL_SLOTS + ((tick >> shift) % LEVEL_SLOTS);
+    }
+}
+
+void link(TimerWheel &wheel, uint32_t t) {
+    auto &timer = wheel.timers[t];
+    // due timers go to the next tick processed
+    uint32_t slot = slot_for(wheel, std::max(timer.tick, wheel.next_tick));
+    timer.slot = slot;
+    timer.prev = NONE;
+    timer.next = wheel.slots[slot];
+    if(timer.next != NONE) wheel.timers[timer.next].prev = t;
+    wheel.slots[slot] = t;
+}
+
+void unlink(TimerWheel &wheel, uint32_t t) {
+    auto &timer = wheel.timers[t];
+    if(timer.prev != NONE) wheel.timers[timer.prev].next = timer.next;
+    else wheel.slots[timer.slot] = timer.next;
+    if(timer.next != NONE) wheel.timers[timer.next].prev = timer.prev;
+}
+
+void release(TimerWheel &wheel, uint32_t t) {
+    auto &timer = wheel.timers[t];
+    wheel.index.erase({timer.entity, timer.kind});
+    timer.slot = NONE;
+    wheel.free_timers.push_back(t);
+}
+
+double schedule(TimerWheel &wheel, int64_t entity, int kind, double fires_at) {
+    auto [it, inserted] = wheel.index.try_emplace({entity, kind}, NONE);
+    uint32_t t = it->second;
+    if(!inserted) {
+        unlink(wheel, t);
+    } else if(!wheel.free_timers.empty()) {
+        t = it->second = wheel.free_timers.back();
+        wheel.free_timers.pop_back();
+    } else {
+        t = it->second = wheel.timers.size();
+        wheel.timers.emplace_back();
+    }
+    auto &timer = wheel.timers[t];
+    timer.entity = entity;
+    timer.kind = kind;
+    timer.fires_at = fires_at;
+    timer.tick = fires_at > 0 ? uint64_t(fires_at / TICK) : 0;
+    link(wheel, t);
+    return fires_at;
+}
+
+bool cancel(TimerWheel &wheel, int64_t entity, int kind) {
+    auto it = wheel.index.find({entity, kind});
+    if(it == wheel.index.end()) return false;
+    unlink(wheel, it->second);
+    release(wheel, it->second);
+    return true;
+}
+
+// Moves the timers of a higher level slot down to the levels they now belong to
+void cascade(TimerWheel &wheel, uint32_t slot) {
+    uint32_t t = wheel.slots[slot];
+    wheel.slots[slot] = NONE;
+    while(t != NONE) {
+        uint32_t next = wheel.timers[t].next;
+        link(wheel, t);
+        t = next;
+    }
+}
+
+void advance(TimerWheel &wheel, double now) {
+    wheel.fired.clear();
+    // time doesn't run backwards, restore() rewinds the wheel together with the database
+    if(!(now >= wheel.now)) return;
+    wheel.now = now;
+    uint64_t target = uint64_t(now / TICK);
+    while(wheel.next_tick <= target) {
+        if(wheel.index.empty()) {
+            wheel.next_tick = target + 1;
+            break;
+        }
+        uint64_t tick = wheel.next_tick;
+        for(int level = 1; level < LEVELS; ++level) {
+            int shift = ROOT_BITS + (level - 1) * LEVEL_BITS;
+            if(tick % (1ull << shift) != 0) break;
+            cascade(wheel, ROOT_SLOTS + (level - 1) * LEVEL_SLOTS + ((tick >> shift) % LEVEL_SLOTS));
+        }
+        uint32_t t = wheel.slots[tick % ROOT_SLOTS];
+        wheel.slots[tick % ROOT_SLOTS] = NONE;
+        wheel.next_tick = tick + 1;
+        while(t != NONE) {
+            auto &timer = wheel.timers[t];
+            uint32_t next = timer.next;
+            if(timer.fires_at <= now) {
+                wheel.fired.push_back({timer.entity, timer.kind, timer.fires_at});
+                release(wheel, t);
+            } else {
+                // later within the tick `now` is in
+                link(wheel, t);
+            }
+            t = next;
+        }
+    }
+}
+
+std::shared_ptr<const void> save(const TimerWheel &wheel) {
+    auto saved = std::make_shared<SavedTimers>();
+    saved->now = wheel.now;
+    saved->next_tick = wheel.next_tick;
+    saved->fired = wheel.fired;
+    saved->pending.reserve(wheel.index.size());
+    for(auto &timer : wheel.timers)
+        if(timer.slot != NONE) saved->pending.push_back({timer.entity, timer.kind, timer.fires_at});
+    return saved;
+}
+
+void load(TimerWheel &wheel, const SavedTimers &saved) {
+    wheel.timers.clear();
+    wheel.free_timers.clear();
+    wheel.index.clear();
+    std::ranges::fill(wheel.slots, NONE);
+    wheel.now = saved.now;
+    wheel.next_tick = saved.next_tick;
+    wheel.fired = saved.fired;
+    for(auto &timer : saved.pending) schedule(wheel, timer.entity, timer.kind, timer.fires_at);
+}
+
+std::string_view kind_arg(sqlite3_value *value) {
+    auto text = (const char*) sqlite3_value_text(value);
+    return text ? std::string_view(text, sqlite3_value_bytes(value)) : std::string_view();
+}
+
+void sql_scheduleTimer(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
+    assert(argc == 3);
+    auto &wheel = *(TimerWheel*) sqlite3_user_data(ctx);
+    if(sqlite3_value_type(argv[0]) == SQLITE_NULL || sqlite3_value_type(argv[2]) == SQLITE_NULL) {
+        sqlite3_result_null(ctx);
+        return;
+    }
+    int kind = intern_kind(wheel, kind_arg(argv[1]));
+    double fires_at = wheel.now + sqlite3_value_double(argv[2]);
+    sqlite3_result_double(ctx, schedule(wheel, sqlite3_value_int64(argv[0]), kind, fires_at));
+}
+
+void sql_cancelTimer(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
+    assert(argc == 2);
+    auto &wheel = *(TimerWheel*) sqlite3_user_data(ctx);
+    int kind = find_kind(wheel, kind_arg(argv[1]));
+    sqlite3_result_int(ctx, kind >= 0 && cancel(wheel, sqlite3_value_int64(argv[0]), kind));
+}
+
+void sql_cancelTimers(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
+    assert(argc == 1);
+    auto &wheel = *(TimerWheel*) sqlite3_user_data(ctx);
+    int64_t entity = sqlite3_value_int64(argv[0]);
+    int cancelled = 0;
+    for(int kind = 0; kind < (int) wheel.kinds.size(); ++kind) cancelled += cancel(wheel, entity, kind);
+    sqlite3_result_int(ctx, cancelled);
+}
+
+void sql_advanceTimers(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
+    assert(argc == 1);
+    auto &wheel = *(TimerWheel*) sqlite3_user_data(ctx);
+    advance(wheel, sqlite3_value_double(argv[0]));
+    sqlite3_result_int64(ctx, wheel.fired.size());
+}
+
+struct FiredTable {
+    sqlite3_vtab base;
+    TimerWheel *wheel;
+};
+
+struct FiredCursor {
+    sqlite3_vtab_cursor base;
+    size_t row;
+    int kind;   // -1 for all of them
+};
+
+int fired_connect(sqlite3 *db, void *aux, int argc, const char *const *argv, sqlite3_vtab **vtab, char **err) {
+    int rc = sqlite3_declare_vtab(db, "create table x(entity_id integer, kind text, fires_at real)");
+    if(rc != SQLITE_OK) return rc;
+    auto table = new FiredTable();
+    table->wheel = (TimerWheel*) aux;
+    *vtab = &table->base;
+    return SQLITE_OK;
+}
+
+int fired_disconnect(sqlite3_vtab *vtab) {
+    delete (FiredTable*) vtab;
+    return SQLITE_OK;
+}
+
+int fired_best_index(sqlite3_vtab *vtab, sqlite3_index_info *info) {
+    info->idxNum = 0;
+    info->estimatedCost = 100;
+    for(int i = 0; i < info->nConstraint; ++i) {
+        auto &c = info->aConstraint[i];
+        if(c.usable && c.iColumn == 1 && c.op == SQLITE_INDEX_CONSTRAINT_EQ) {
+            info->idxNum = 1;
+            info->aConstraintUsage[i].argvIndex = 1;
+            info->aConstraintUsage[i].omit = 1;
+            info->estimatedCost = 10;
+            break;
+        }
+    }
+    return SQLITE_OK;
+}
+
+int fired_open(sqlite3_vtab *vtab, sqlite3_vtab_cursor **cursor) {
+    auto cur = new FiredCursor();
+    *cursor = &cur->base;
+    return SQLITE_OK;
+}
+
+int fired_close(sqlite3_vtab_cursor *cursor) {
+    delete (FiredCursor*) cursor;
+    return SQLITE_OK;
+}
+
+void skip_other_kinds(FiredCursor *cur, const TimerWheel &wheel) {
+    if(cur->kind < 0) return;
+    while(cur->row < wheel.fired.size() && wheel.fired[cur->row].kind != cur->kind) cur->row++;
+}
+
+int fired_filter(sqlite3_vtab_cursor *cursor, int idxNum, const char *idxStr, int argc, sqlite3_value **argv) {
+    auto cur = (FiredCursor*) cursor;
+    auto &wheel = *((FiredTable*) cursor->pVtab)->wheel;
+    cur->row = 0;
+    cur->kind = -1;
+    if(idxNum == 1) {
+        cur->kind = find_kind(wheel, kind_arg(argv[0]));
+        // a kind nothing was ever scheduled with
+        if(cur->kind < 0) cur->row = wheel.fired.size();
+    }
+    skip_other_kinds(cur, wheel);
+    return SQLITE_OK;
+}
+
+int fired_next(sqlite3_vtab_cursor *cursor) {
+    auto cur = (FiredCursor*) cursor;
+    cur->row++;
+    skip_other_kinds(cur, *((FiredTable*) cursor->pVtab)->wheel);
+    return SQLITE_OK;
+}
+
+int fired_eof(sqlite3_vtab_cursor *cursor) {
+    auto cur = (FiredCursor*) cursor;
+    return cur->row >= ((FiredTable*) cursor->pVtab)->wheel->fired.size();
+}
+
+int fired_column(sqlite3_vtab_cursor *cursor, sqlite3_context *ctx, int col) {
+    auto cur = (FiredCursor*) cursor;
+    auto &wheel = *((FiredTable*) cursor->pVtab)->wheel;
+    auto &timer = wheel.fired[cur->row];
+    switch(col) {
+        case 0: sqlite3_result_int64(ctx, timer.entity); break;
+        case 1: sqlite3_result_text(ctx, wheel.kinds[timer.kind].c_str(), -1, SQLITE_STATIC); break;
+        case 2: sqlite3_result_double(ctx, timer.fires_at); break;
+    }
+    return SQLITE_OK;
+}
+
+int fired_rowid(sqlite3_vtab_cursor *cursor, sqlite3_int64 *rowid) {
+    *rowid = ((FiredCursor*) cursor)->row + 1;
+    return SQLITE_OK;
+}
+
+sqlite3_module fired_module = {
+    .iVersion = 0,
+    .xConnect = fired_connect,
+    .xBestIndex = fired_best_index,
+    .xDisconnect = fired_disconnect,
+    .xOpen = fired_open,
+    .xClose = fired_close,
+    .xFilter = fired_filter,
+    .xNext = fired_next,
+    .xEof = fired_eof,
+    .xColumn = fired_column,
+    .xRowid = fired_rowid,
+};
+
+void destroy_wheel(void *p) {
+    auto wheel = (TimerWheel*) p;
+    remove_snapshot_state(&wheel->snapshot_state);
+    delete wheel;
+}
+
+void create_timer_functions(sqlite3 *db) {
+    auto wheel = new TimerWheel();
+    wheel->snapshot_state = {
+        db,
+        [wheel] { return save(*wheel); },
+        [wheel](const void *saved) { load(*wheel, *(const SavedTimers*) saved); },
+    };
+    add_snapshot_state(&wheel->snapshot_state);
+    int rc = sqlite3_create_module_v2(db, "fired_timers", &fired_module, wheel, destroy_wheel);
+    if(rc != SQLITE_OK) throw std::runtime_error("failed to create virtual table module");
+    rc = sqlite3_create_function(db, "scheduleTimer", 3, SQLITE_UTF8, wheel, sql_scheduleTimer, nullptr, nullptr);
+    if(rc == SQLITE_OK) rc = sqlite3_create_function(db, "cancelTimer", 2, SQLITE_UTF8, wheel, sql_cancelTimer, nullptr, nullptr);
+    if(rc == SQLITE_OK) rc = sqlite3_create_function(db, "cancelTimers", 1, SQLITE_UTF8, wheel, sql_cancelTimers, nullptr, nullptr);
+    if(rc == SQLITE_OK) rc = sqlite3_create_function(db, "advanceTimers", 1, SQLITE_UTF8, wheel, sql_advanceTimers, nullptr, nullptr);
+    if(rc != SQLITE_OK) throw std::runtime_error("failed to create function");
+}
+
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+struct sqlite3;
+
+namespace sqhell {
+
+// Registers a hierarchical timer wheel, for expirations and cooldowns that would otherwise
+// be counted down on every row every frame:
+//   scheduleTimer(entity_id, kind, delay) - fires `delay` seconds after the last advanceTimers(),
+//       replacing the entity's pending timer of that kind; returns when it fires
+//   cancelTimer(entity_id, kind), cancelTimers(entity_id) - number of timers cancelled
+//   advanceTimers(now) - moves the wheel to `now` seconds and returns how many timers fired
+//   fired_timers(entity_id, kind, fires_at) - eponymous table of the timers the last advanceTimers() fired
+// Scheduling and cancelling are O(1) and advancing costs the timers that fire plus a
+// millisecond tick per step, however many are pending. Pending timers are saved with every
+// snapshot and rewound by restore().
+void create_timer_functions(sqlite3 *db);
+
+}
@@ -0,0 +1,618 @@
+#include <update_fusion.h>
+#include <script.h>
+#include <host_params.h>
+#include <logger.h>
+#include <sqlite3.h>
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace sqhell {
+
+// Every statement folded in repeats the expressions of the previous ones,
+// a run is cut short once its merged statement gets this long
+constexpr size_t MAX_FUSED_SQL = 16384;
+
+struct Token {
+    enum Kind { word, quoted, string, number, param, symbol } kind;
+    std::string text;   // as written
+    std::string name;   // lowercase identifier for words and quoted identifiers
+};
+
+const std::unordered_set<std::string_view> expression_keywords = {
+    "and", "or", "not", "is", "null", "notnull", "isnull", "case", "when", "then", "else", "end",
+    "in", "between", "like", "glob", "regexp", "match", "escape", "collate", "cast", "as",
+    "exists", "distinct", "true", "false",
+};
+
+// Built-in functions that always return the same result for the same arguments,
+// unless the host registered its own function under the name
+const std::unordered_set<std::string_view> deterministic_functions = {
+    "abs", "min", "max", "iif", "coalesce", "ifnull", "nullif", "typeof", "length", "lower", "upper",
+    "substr", "substring", "trim", "ltrim", "rtrim", "replace", "instr", "printf", "format", "quote",
+    "round", "sign", "ceil", "ceiling", "floor", "trunc", "sqrt", "pow", "power", "exp", "ln", "log",
+    "log2", "log10", "mod", "pi", "sin", "cos", "tan", "asin", "acos", "atan", "atan2", "sinh", "cosh",
+    "tanh", "degrees", "radians", "hex", "unhex", "unicode", "char", "likely", "unlikely",
+    // aggregates, only found in subqueries
+    "count", "sum", "total", "avg", "group_concat", "string_agg",
+};
+
+std::string lowercase(std::string_view s) {
+    std::string out(s);
+    for(auto &c : out) c = (char) tolower((unsigned char) c);
+    return out;
+}
+
+bool is_word_char(char c) { return isalnum((unsigned char) c) || c == '_' || c == '$'; }
+
+bool tokenize(std::string_view sql, std::vector<Token> &tokens) {
+    static const char *operators[] = {"->>", "||", "<=", ">=", "<>", "!=", "==", "<<", ">>", "->"};
+    size_t i = 0;
+    while(i < sql.size()) {
+        char c = sql[i];
+        if(isspace((unsigned char) c)) { ++i; continue; }
+        if(sql.substr(i, 2) == "--") {
+            while(i < sql.size() && sql[i] != '\n') ++i;
+            continue;
+        }
+        if(sql.substr(i, 2) == "/*") {
+            size_t end = sql.find("*/", i + 2);
+            i = end == std::string_view::npos ? sql.size() : end + 2;
+            continue;
+        }
+        size_t begin = i;
+        if(isalpha((unsigned char) c) || c == '_') {
+            while(i < sql.size() && is_word_char(sql[i])) ++i;
+            tokens.push_back({Token::word, std::string(sql.substr(begin, i - begin)), lowercase(sql.substr(begin, i - begin))});
+        } else if(isdigit((unsigned char) c) || (c == '.' && i+1 < sql.size() && isdigit((unsigned char) sql[i+1]))) {
+            while(i < sql.size() && (is_word_char(sql[i]) || sql[i] == '.' ||
+                ((sql[i] == '+' || sql[i] == '-') && (sql[i-1] == 'e' || sql[i-1] == 'E')))) ++i;
+            tokens.push_back({Token::number, std::string(sql.substr(begin, i - begin)), ""});
+        } else if(c == '\'' || c == '"' || c == '`' || c == '[') {
+            char close = c == '[' ? ']' : c;
+            for(++i; i < sql.size(); ++i) {
+                if(sql[i] != close) continue;
+                if(close != ']' && i+1 < sql.size() && sql[i+1] == close) { ++i; continue; }
+                break;
+            }
+            if(i >= sql.size()) return false;
+            ++i;
+            auto text = std::string(sql.substr(begin, i - begin));
+            if(c == '\'') tokens.push_back({Token::string, text, ""});
+            else tokens.push_back({Token::quoted, text, lowercase(sql.substr(begin + 1, i - begin - 2))});
+        } else if((c == ':' || c == '@' || c == '$') && i+1 < sql.size() && is_word_char(sql[i+1])) {
+            for(++i; i < sql.size() && is_word_char(sql[i]); ++i);
+            tokens.push_back({Token::param, std::string(sql.substr(begin, i - begin)), ""});
+        } else if(c == '?') {
+            return false; // numbered parameters would be renumbered by the merge
+        } else {
+            size_t length = 1;
+            for(auto op : operators)
+                if(sql.substr(i, strlen(op)) == op) { length = strlen(op); break; }
+            tokens.push_back({Token::symbol, std::string(sql.substr(i, length)), ""});
+            i += length;
+        }
+    }
+    return true;
+}
+
+using Expr = std::vector<Token>;
+
+struct Update {
+    std::string table;
+    std::vector<std::pair<std::string, Expr>> sets;
+    Expr where;     // empty when every row is updated
+};
+
+bool is_identifier(const Token &t) { return t.kind == Token::word || t.kind == Token::quoted; }
+bool is_word(const Token &t, const char *word) { return t.kind == Token::word && t.name == word; }
+bool is_symbol(const Token &t, const char *symbol) { return t.kind == Token::symbol && t.text == symbol; }
+
+// Collects an expression up to a top-level comma or one of the clause keywords
+size_t read_expr(const std::vector<Token> &tokens, size_t i, Expr &expr) {
+    int depth = 0;
+    for(; i < tokens.size(); ++i) {
+        auto &t = tokens[i];
+        if(depth == 0 && (is_symbol(t, ",") || is_symbol(t, ";") || is_word(t, "from") || is_word(t, "where") ||
+            is_word(t, "returning") || is_word(t, "order") || is_word(t, "limit"))) break;
+        if(is_symbol(t, "(")) ++depth;
+        if(is_symbol(t, ")") && --depth < 0) return SIZE_MAX;
+        expr.push_back(t);
+    }
+    return depth == 0 && !expr.empty() ? i : SIZE_MAX;
+}
+
+// Accepts `update table set column = expr, ... [where expr] [;]` and nothing else
+bool parse_update(const std::vector<Token> &tokens, Update &update) {
+    size_t i = 0;
+    if(tokens.size() < 5 || !is_word(tokens[0], "update") || !is_identifier(tokens[1]) || !is_word(tokens[2], "set")) return false;
+    update.table = tokens[1].name;
+    for(i = 3;;) {
+        if(i+1 >= tokens.size() || !is_identifier(tokens[i]) || !is_symbol(tokens[i+1], "=")) return false;
+        Expr expr;
+        auto column = tokens[i].name;
+        i = read_expr(tokens, i + 2, expr);
+        if(i == SIZE_MAX) return false;
+        update.sets.push_back({column, std::move(expr)});
+        if(i < tokens.size() && is_symbol(tokens[i], ",")) ++i;
+        else break;
+    }
+    if(i < tokens.size() && is_word(tokens[i], "where")) {
+        i = read_expr(tokens, i + 1, update.where);
+        if(i == SIZE_MAX) return false;
+    }
+    if(i < tokens.size() && is_symbol(tokens[i], ";")) ++i;
+    return i == tokens.size();
+}
+
+struct Column {
+    std::string type;   // integer, real, text, blob or any
+    bool primary_key = false;
+};
+
+struct Table {
+    std::unordered_map<std::string, Column> columns;
+    bool fusable = false;
+};
+
+struct Schema {
+    std::unordered_map<std::string, std::string> objects;   // name -> type, "virtual" for virtual tables
+    std::unordered_map<std::string, Table> tables;
+    std::unordered_set<std::string> host_functions;
+};
+
+bool is_deterministic(const Schema &schema, const std::string &function) {
+    return deterministic_functions.contains(function) && !schema.host_functions.contains(function);
+}
+
+Schema read_schema(sqlite3 *db) {
+    Schema schema;
+    sqlite3_stmt *stmt;
+    std::unordered_set<std::string> triggered;
+    if(sqlite3_prepare_v2(db, "select type, name, tbl_name, sql from sqlite_schema", -1, &stmt, nullptr) == SQLITE_OK) {
+        while(sqlite3_step(stmt) == SQLITE_ROW) {
+            auto type = lowercase((const char*) sqlite3_column_text(stmt, 0));
+            auto name = lowercase((const char*) sqlite3_column_text(stmt, 1));
+            auto sql = sqlite3_column_text(stmt, 3);
+            if(type == "trigger") triggered.insert(lowercase((const char*) sqlite3_column_text(stmt, 2)));
+            if(type == "table" && sql && lowercase((const char*) sql).starts_with("create virtual")) type = "virtual";
+            schema.objects[name] = type;
+        }
+    }
+    sqlite3_finalize(stmt);
+
+    // Only strict tables: their columns convert values predictably, so a value a merged
+    // statement passes on can be converted the same way the stored one would have been
+    const char *columns_sql = "select lower(t.name), lower(c.name), upper(c.type), c.pk from pragma_table_list t, "
+        "pragma_table_info(t.name) c where t.schema = 'main' and t.type = 'table' and t.strict";
+    if(sqlite3_prepare_v2(db, columns_sql, -1, &stmt, nullptr) == SQLITE_OK) {
+        while(sqlite3_step(stmt) == SQLITE_ROW) {
+            std::string table = (const char*) sqlite3_column_text(stmt, 0);
+            auto &t = schema.tables[table];
+            t.fusable = !triggered.contains(table);
+            std::string type = (const char*) sqlite3_column_text(stmt, 2);
+            type = type == "INT" || type == "INTEGER" ? "integer" : type == "REAL" ? "real" : type == "TEXT" ? "text" : type == "BLOB" ? "blob" : "any";
+            t.columns[(const char*) sqlite3_column_text(stmt, 1)] = {type, sqlite3_column_int(stmt, 3) > 0};
+        }
+    }
+    sqlite3_finalize(stmt);
+
+    // the copies the merges are tested on don't have the host's functions, so they can't tell
+    // that one with a built-in's name has side effects, like log()
+    if(sqlite3_prepare_v2(db, "select lower(name) from pragma_function_list where not builtin", -1, &stmt, nullptr) == SQLITE_OK) {
+        while(sqlite3_step(stmt) == SQLITE_ROW)
+            schema.host_functions.insert((const char*) sqlite3_column_text(stmt, 0));
+    }
+    sqlite3_finalize(stmt);
+    return schema;
+}
+
+size_t matching_paren(const Expr &expr, size_t open) {
+    int depth = 0;
+    for(size_t i = open; i < expr.size(); ++i) {
+        if(is_symbol(expr[i], "(")) ++depth;
+        if(is_symbol(expr[i], ")") && --depth == 0) return i;
+    }
+    return SIZE_MAX;
+}
+
+bool is_rowid(const std::string &name) { return name == "rowid" || name == "oid" || name == "_rowid_"; }
+
+// A subquery can't be correlated with the updated table or read anything that might change while
+// it runs, since the merged statement evaluates it in another place and maybe more often
+bool check_subquery(const Expr &expr, size_t begin, size_t end, const Schema &schema, const std::string &table, const Table &t) {
+    bool in_from = false;
+    for(size_t i = begin; i < end; ++i) {
+        auto &tok = expr[i];
+        if(is_word(tok, "from")) in_from = true;
+        else if(is_word(tok, "where") || is_word(tok, "group") || is_word(tok, "order") || is_word(tok, "limit") ||
+            is_symbol(tok, "(") || is_symbol(tok, ")")) in_from = false;
+        if(!is_identifier(tok)) continue;
+        // everything read has to be an ordinary table, not a view or a virtual table
+        if(in_from && i > begin && (is_word(expr[i-1], "from") || is_word(expr[i-1], "join") || is_symbol(expr[i-1], ","))) {
+            auto object = schema.objects.find(tok.name);
+            if(object == schema.objects.end() || object->second != "table") return false;
+        }
+        if(tok.kind == Token::word && i+1 < end && is_symbol(expr[i+1], "(")) {
+            if(!is_deterministic(schema, tok.name) && !expression_keywords.contains(tok.name)) return false;
+            continue;
+        }
+        if(tok.name == table || t.columns.contains(tok.name) || is_rowid(tok.name)) return false;
+    }
+    return true;
+}
+
+// Checks that the expression only reads the row and constants. `columns[i]` is set for tokens
+// that refer to a column of the updated table, the ones the merge substitutes.
+bool check_expr(const Expr &expr, const Schema &schema, const std::string &table, const Table &t, std::vector<bool> &columns) {
+    columns.assign(expr.size(), false);
+    for(size_t i = 0; i < expr.size(); ++i) {
+        auto &tok = expr[i];
+        if(is_symbol(tok, "(") && i+1 < expr.size() && (is_word(expr[i+1], "select") || is_word(expr[i+1], "with"))) {
+            size_t close = matching_paren(expr, i);
+            if(close == SIZE_MAX || !check_subquery(expr, i + 1, close, schema, table, t)) return false;
+            i = close;
+            continue;
+        }
+        if(is_symbol(tok, ".")) return false;   // table.column
+        if(!is_identifier(tok)) continue;
+        bool call = i+1 < expr.size() && is_symbol(expr[i+1], "(");
+        if(tok.kind == Token::word && expression_keywords.contains(tok.name)) continue;
+        if(tok.kind == Token::word && call) {
+            if(!is_deterministic(schema, tok.name)) return false;
+            continue;
+        }
+        // type names of cast(x as type) and collation names
+        if(i > 0 && (is_word(expr[i-1], "as") || is_word(expr[i-1], "collate"))) continue;
+        if(is_rowid(tok.name)) continue;
+        if(!t.columns.contains(tok.name)) return false;
+        columns[i] = true;
+    }
+    return true;
+}
+
+struct Candidate {
+    Update update;
+    std::vector<bool> where_columns;
+    std::vector<std::vector<bool>> set_columns;
+};
+
+bool make_candidate(sqlite3_stmt *stmt, const Schema &schema, Candidate &c) {
+    std::vector<Token> tokens;
+    if(!tokenize(sqlite3_sql(stmt), tokens) || !parse_update(tokens, c.update)) return false;
+    auto table = schema.tables.find(c.update.table);
+    if(table == schema.tables.end() || !table->second.fusable) return false;
+    auto &t = table->second;
+    if(!check_expr(c.update.where, schema, c.update.table, t, c.where_columns)) return false;
+    c.set_columns.resize(c.update.sets.size());
+    for(size_t i = 0; i < c.update.sets.size(); ++i) {
+        auto &[column, expr] = c.update.sets[i];
+        if(!t.columns.contains(column) || is_rowid(column)) return false;
+        // changing the primary key moves the row, later statements would look for it elsewhere
+        if(t.columns.at(column).primary_key) return false;
+        if(!check_expr(expr, schema, c.update.table, t, c.set_columns[i])) return false;
+    }
+    return true;
+}
+
+// Works out the storage class every non-null value of an expression has, from the types of the
+// columns it reads and the operators and functions it applies. Gives up on anything else.
+struct TypeReader {
+    const Expr &expr;
+    const Table &t;
+    size_t i = 0;
+    bool failed = false;
+
+    bool at_symbol(const char *symbol) const { return i < expr.size() && is_symbol(expr[i], symbol); }
+
+    void expect(const char *symbol) {
+        if(at_symbol(symbol)) ++i;
+        else failed = true;
+    }
+
+    // Levels from the loosest: + -, * / %, ||
+    std::string binary(int level) {
+        static const std::vector<std::vector<const char*>> operators = {{"+", "-"}, {"*", "/", "%"}, {"||"}};
+        if(level == (int) operators.size()) return unary();
+        auto type = binary(level + 1);
+        while(!failed && i < expr.size()) {
+            auto op = std::ranges::find_if(operators[level], [&](auto o) { return is_symbol(expr[i], o); });
+            if(op == operators[level].end()) break;
+            ++i;
+            auto right = binary(level + 1);
+            // integer arithmetic falls back to real on overflow
+            if(level == 2) type = "text";
+            else if(strcmp(*op, "%") != 0 && (type == "real" || right == "real")) type = "real";
+            else type.clear();
+        }
+        return type;
+    }
+
+    std::string call(const std::string &name) {
+        std::vector<std::string> args;
+        expect("(");
+        while(!failed && !at_symbol(")")) {
+            args.push_back(binary(0));
+            if(!at_symbol(")")) expect(",");
+        }
+        expect(")");
+        static const std::unordered_set<std::string_view> real_functions = {
+            "sqrt", "pow", "power", "exp", "ln", "log", "log2", "log10", "pi", "sin", "cos", "tan", "asin", "acos",
+            "atan", "atan2", "sinh", "cosh", "tanh", "degrees", "radians", "round",
+        };
+        bool same = !args.empty() && std::ranges::all_of(args, [&](auto &a) { return a == args[0]; });
+        if(real_functions.contains(name)) return "real";
+        if(name == "min" || name == "max" || name == "coalesce" || name == "ifnull") return same ? args[0] : "";
+        if(name == "abs" || name == "ceil" || name == "ceiling" || name == "floor" || name == "trunc")
+            return args.size() == 1 && args[0] == "real" ? "real" : "";
+        if(name == "lower" || name == "upper" || name == "printf" || name == "format" || name == "hex" || name == "quote") return "text";
+        return "";
+    }
+
+    std::string unary() {
+        if(i >= expr.size()) {
+            failed = true;
+            return "";
+        }
+        if(at_symbol("-") || at_symbol("+")) {
+            ++i;
+            return unary() == "real" ? "real" : "";
+        }
+        if(at_symbol("(")) {
+            ++i;
+            auto type = binary(0);
+            expect(")");
+            return type;
+        }
+        auto &tok = expr[i++];
+        switch(tok.kind) {
+            case Token::number: {
+                if(tok.text.find_first_of(".eE") != std::string::npos && !tok.text.starts_with("0x") && !tok.text.starts_with("0X")) return "real";
+                int64_t value;
+                auto end = tok.text.data() + tok.text.size();
+                return std::from_chars(tok.text.data(), end, value).ptr == end ? "integer" : "";
+            }
+            case Token::string: return "text";
+            case Token::param: return "";
+            case Token::word:
+                if(tok.name == "cast" && at_symbol("(")) {
+                    ++i;
+                    binary(0);
+                    if(i >= expr.size() || !is_word(expr[i], "as")) failed = true;
+                    std::string type = ++i < expr.size() ? expr[i++].name : "";
+                    expect(")");
+                    return type == "int" ? "integer" : type == "integer" || type == "real" || type == "text" ? type : "";
+                }
+                if(at_symbol("(")) return call(tok.name);
+                [[fallthrough]];
+            case Token::quoted: {
+                if(is_rowid(tok.name)) return "integer";
+                auto column = t.columns.find(tok.name);
+                if(column != t.columns.end()) return column->second.type;
+                break;
+            }
+            case Token::symbol: break;
+        }
+        failed = true;
+        return "";
+    }
+};
+
+// Empty when the type isn't known
+std::string value_type(const Expr &expr, const Table &t) {
+    TypeReader reader{expr, t};
+    auto type = reader.binary(0);
+    return reader.failed || reader.i != expr.size() ? "" : type;
+}
+
+// The merged statement stores only the last value each row gets. Storing a value in a strict column
+// converts some of them (3 into REAL, '3' into INTEGER) and rejects others, so a value a later
+// statement of the run reads or overwrites has to have the column's type already.
+bool passes_values_on(const std::vector<Candidate> &run, const Table &t) {
+    auto uses = [](const Candidate &c, const std::string &column) {
+        auto reads = [&](const Expr &expr, const std::vector<bool> &columns) {
+            for(size_t i = 0; i < expr.size(); ++i)
+                if(columns[i] && expr[i].name == column) return true;
+            return false;
+        };
+        if(reads(c.update.where, c.where_columns)) return true;
+        for(size_t i = 0; i < c.update.sets.size(); ++i)
+            if(c.update.sets[i].first == column || reads(c.update.sets[i].second, c.set_columns[i])) return true;
+        return false;
+    };
+    for(size_t j = 0; j < run.size(); ++j) {
+        for(auto &[column, expr] : run[j].update.sets) {
+            auto &type = t.columns.at(column).type;
+            if(type == "any") continue;
+            bool used = std::any_of(run.begin() + j + 1, run.end(), [&](auto &c) { return uses(c, column); });
+            if(used && value_type(expr, t) != type) return false;
+        }
+    }
+    return true;
+}
+
+std::string quote_identifier(const std::string &name) { return "\"" + name + "\""; }
+
+// Renders the expression against the values earlier statements of the run assigned
+std::string render(const Expr &expr, const std::vector<bool> &columns, const std::unordered_map<std::string, std::string> &values) {
+    std::string out;
+    for(size_t i = 0; i < expr.size(); ++i) {
+        if(!out.empty()) out += ' ';
+        auto value = columns[i] ? values.find(expr[i].name) : values.end();
+        out += value == values.end() ? expr[i].text : "(" + value->second + ")";
+    }
+    return out;
+}
+
+std::string merge(const std::vector<Candidate> &run) {
+    std::unordered_map<std::string, std::string> values;
+    std::vector<std::string> order, predicates;
+    for(auto &c : run) {
+        auto predicate = c.update.where.empty() ? std::string("1") : render(c.update.where, c.where_columns, values);
+        predicates.push_back(predicate);
+        std::vector<std::pair<std::string, std::string>> assigned;
+        for(size_t i = 0; i < c.update.sets.size(); ++i) {
+            auto &[column, expr] = c.update.sets[i];
+            auto old = values.contains(column) ? values[column] : quote_identifier(column);
+            assigned.push_back({column, "case when (" + predicate + ") then (" + render(expr, c.set_columns[i], values) +
+                ") else (" + old + ") end"});
+        }
+        for(auto &[column, value] : assigned) {
+            if(!values.contains(column)) order.push_back(column);
+            values[column] = value;
+        }
+    }
+    std::string sql = "update " + quote_identifier(run[0].update.table) + " set ";
+    for(size_t i = 0; i < order.size(); ++i)
+        sql += (i ? ", " : "") + quote_identifier(order[i]) + " = " + values[order[i]];
+    sql += " where ";
+    for(size_t i = 0; i < predicates.size(); ++i)
+        sql += (i ? " or (" : "(") + predicates[i] + ")";
+    return sql;
+}
+
+// Copy of the database in a connection of its own, without any of the host's functions
+sqlite3 *copy_database(sqlite3 *db) {
+    sqlite3 *copy;
+    int rc = sqlite3_open_v2(":memory:", &copy, SQLITE_OPEN_READWRITE, nullptr);
+    if(rc == SQLITE_OK) {
+        auto backup = sqlite3_backup_init(copy, "main", db, "main");
+        rc = backup ? sqlite3_backup_step(backup, -1) : SQLITE_ERROR;
+        sqlite3_backup_finish(backup);
+    }
+    if(rc != SQLITE_DONE) {
+        sqlite3_close(copy);
+        return nullptr;
+    }
+    return copy;
+}
+
+bool table_contents(sqlite3 *db, const std::string &table, std::string &out) {
+    sqlite3_stmt *stmt;
+    auto sql = "select * from " + quote_identifier(table) + " order by rowid";
+    if(sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) return false;
+    int rc;
+    while((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        for(int i = 0; i < sqlite3_column_count(stmt); ++i) {
+            int type = sqlite3_column_type(stmt, i);
+            out += (char) type;
+            if(type == SQLITE_INTEGER) {
+                auto v = sqlite3_column_int64(stmt, i);
+                out.append((const char*) &v, sizeof(v));
+            } else if(type == SQLITE_FLOAT) {
+                auto v = sqlite3_column_double(stmt, i);
+                out.append((const char*) &v, sizeof(v));
+            } else if(type != SQLITE_NULL) {
+                auto v = (const char*) sqlite3_column_blob(stmt, i);
+                out.append(v, sqlite3_column_bytes(stmt, i));
+                out += '\0';
+            }
+        }
+    }
+    sqlite3_finalize(stmt);
+    return rc == SQLITE_DONE;
+}
+
+bool run_on_copy(sqlite3 *db, const std::vector<std::string> &statements, const std::string &table, std::string &contents) {
+    auto copy = copy_database(db);
+    if(!copy) return false;
+    bool ok = true;
+    for(auto &sql : statements) {
+        sqlite3_stmt *stmt;
+        ok = sqlite3_prepare_v2(copy, sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK;
+        // host parameters get their current values from the original connection
+        if(ok) bind_params(stmt, find_params(db, stmt));
+        if(ok) ok = sqlite3_step(stmt) == SQLITE_DONE;
+        sqlite3_finalize(stmt);
+        if(!ok) break;
+    }
+    if(ok) ok = table_contents(copy, table, contents);
+    sqlite3_close(copy);
+    return ok;
+}
+
+enum class Verdict { same, different, failed };
+
+Verdict compare_results(sqlite3 *db, const std::vector<ScriptStatement> &originals, const std::string &merged, const std::string &table) {
+    std::vector<std::string> sqls;
+    for(auto &s : originals) sqls.push_back(sqlite3_sql(s.stmt));
+    std::string expected, actual;
+    if(!run_on_copy(db, sqls, table, expected) || !run_on_copy(db, {merged}, table, actual)) return Verdict::failed;
+    return expected == actual ? Verdict::same : Verdict::different;
+}
+
+int fuse_updates(sqlite3 *db, Script &script) {
+    auto schema = read_schema(db);
+    auto &statements = script.statements;
+
+    // a run can't continue past the end of a block
+    std::unordered_set<size_t> block_ends;
+    for(auto &s : statements)
+        if(s.kind != StatementKind::sql) block_ends.insert(s.block_end);
+
+    std::vector<ScriptStatement> fused;
+    std::vector<size_t> new_index(statements.size() + 1);
+    int saved = 0;
+    for(size_t i = 0; i < statements.size();) {
+        std::vector<Candidate> run;
+        std::string merged;
+        size_t end = i;
+        for(; end < statements.size(); ++end) {
+            if(end > i && block_ends.contains(end)) break;
+            Candidate c;
+            if(statements[end].kind != StatementKind::sql || !make_candidate(statements[end].stmt, schema, c)) break;
+            if(!run.empty() && c.update.table != run[0].update.table) break;
+            run.push_back(std::move(c));
+            if(run.size() == 1) continue;
+            auto sql = merge(run);
+            if(sql.size() > MAX_FUSED_SQL || !passes_values_on(run, schema.tables.at(run[0].update.table))) {
+                run.pop_back();
+                break;
+            }
+            merged = std::move(sql);
+        }
+        if(run.size() < 2) {
+            new_index[i] = fused.size();
+            fused.push_back(statements[i++]);
+            continue;
+        }
+
+        end = i + run.size();
+        std::vector<ScriptStatement> originals(statements.begin() + i, statements.begin() + end);
+        sqlite3_stmt *stmt = nullptr;
+        auto verdict = compare_results(db, originals, merged, run[0].update.table);
+        if(verdict != Verdict::same || sqlite3_prepare_v3(db, merged.c_str(), -1, SQLITE_PREPARE_PERSISTENT, &stmt, nullptr) != SQLITE_OK) {
+            log_message(LOG_WARN, "Not fusing the UPDATEs at lines %d-%d: %s", originals.front().line, originals.back().line,
+                verdict == Verdict::different ? "the merged statement changes the result" : "failed to test the merged statement");
+            sqlite3_finalize(stmt);
+            for(; i < end; ++i) {
+                new_index[i] = fused.size();
+                fused.push_back(statements[i]);
+            }
+            continue;
+        }
+        log_message(LOG_INFO, "Fused %zu UPDATEs on %s at lines %d-%d into one", run.size(),
+            run[0].update.table.c_str(), originals.front().line, originals.back().line);
+        saved += run.size() - 1;
+        for(auto &s : originals) sqlite3_finalize(s.stmt);
+        for(; i < end; ++i) new_index[i] = fused.size();
+        fused.push_back({stmt, originals.front().line});
+        fused.back().params = find_params(db, stmt);
+        fused.back().hot = std::ranges::any_of(originals, &ScriptStatement::hot);
+        fused.back().setup = std::ranges::all_of(originals, &ScriptStatement::setup);
+    }
+    new_index[statements.size()] = fused.size();
+    for(auto &s : fused)
+        if(s.kind != StatementKind::sql) s.block_end = new_index[s.block_end];
+    statements = std::move(fused);
+    if(saved) log_message(LOG_INFO, "Fusing UPDATEs saves %d table scans per frame", saved);
+    return saved;
+}
+
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+struct sqlite3;
+
+namespace sqhell {
+
+struct Script;
+
+// Merges runs of adjacent UPDATEs on the same table into one statement, so the table is
+// scanned and its rows rewritten once instead of once per statement:
+//   update t set a = f(a) where p;  update t set b = g(a, b) where q;
+// becomes
+//   update t set a = case when p then f(a) else a end,
+//                b = case when q then g(<new a>, b) else b end where p or q;
+// Only plain `update ... set ... where ...` statements without FROM or RETURNING on tables
+// without triggers are merged, and only when every expression is deterministic: built-in
+// functions from a fixed list that the host didn't replace, and subqueries that read ordinary
+// tables other than the updated one. A value a later statement reads or overwrites (<new a>
+// above) must have the column's type already, like `x + vx * :dt` in a REAL column, since only
+// the last one is stored. Runs don't cross `-- @if`/`-- @repeat` block boundaries.
+//
+// Each merge is checked by differential testing: the original statements and the merged
+// one run on two copies of the current database, and the merge is dropped unless the
+// updated table ends up identical. Returns the number of table scans saved per frame.
+int fuse_updates(sqlite3 *db, Script &script);
+
+}
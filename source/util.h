@@ -1,7 +0,0 @@
-#pragma once
-
-namespace sqhell {
-
-char *read_text(const char *path);
-
-}
\ No newline at end of file
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <sqlite3.h>
+#include <stdexcept>
+#include <cstring>
+#include <cstddef>
+
+namespace sqhell {
+
+// Read-only eponymous virtual table (usable without CREATE VIRTUAL TABLE)
+// over rows owned by the host. Table must provide:
+//   static constexpr const char *schema;  // "create table x(...)"
+//   static size_t row_count();
+//   static void column(size_t row, sqlite3_context *ctx, int col);
+// Rows are scanned in order; rowid is the row index + 1.
+template<class Table>
+struct EponymousTable {
+
+    struct Cursor {
+        sqlite3_vtab_cursor base;
+        size_t row;
+    };
+
+    static int connect(sqlite3 *db, void *aux, int argc, const char *const *argv, sqlite3_vtab **vtab, char **err) {
+        int rc = sqlite3_declare_vtab(db, Table::schema);
+        if(rc != SQLITE_OK) return rc;
+        *vtab = (sqlite3_vtab*) sqlite3_malloc(sizeof(sqlite3_vtab));
+        if(!*vtab) return SQLITE_NOMEM;
+        memset(*vtab, 0, sizeof(sqlite3_vtab));
+        return SQLITE_OK;
+    }
+
+    static int disconnect(sqlite3_vtab *vtab) {
+        sqlite3_free(vtab);
+        return SQLITE_OK;
+    }
+
+    static int best_index(sqlite3_vtab *vtab, sqlite3_index_info *info) {
+        info->estimatedCost = Table::row_count() + 1;
+        info->estimatedRows = Table::row_count();
+        return SQLITE_OK;
+    }
+
+    static int open(sqlite3_vtab *vtab, sqlite3_vtab_cursor **cursor) {
+        auto cur = (Cursor*) sqlite3_malloc(sizeof(Cursor));
+        if(!cur) return SQLITE_NOMEM;
+        memset(cur, 0, sizeof(*cur));
+        *cursor = &cur->base;
+        return SQLITE_OK;
+    }
+
+    static int close(sqlite3_vtab_cursor *cursor) {
+        sqlite3_free(cursor);
+        return SQLITE_OK;
+    }
+
+    static int filter(sqlite3_vtab_cursor *cursor, int idxNum, const char *idxStr, int argc, sqlite3_value **argv) {
+        ((Cursor*) cursor)->row = 0;
+        return SQLITE_OK;
+    }
+
+    static int next(sqlite3_vtab_cursor *cursor) {
+        ((Cursor*) cursor)->row++;
+        return SQLITE_OK;
+    }
+
+    static int eof(sqlite3_vtab_cursor *cursor) {
+        return ((Cursor*) cursor)->row >= Table::row_count();
+    }
+
+    static int column(sqlite3_vtab_cursor *cursor, sqlite3_context *ctx, int col) {
+        Table::column(((Cursor*) cursor)->row, ctx, col);
+        return SQLITE_OK;
+    }
+
+    static int rowid(sqlite3_vtab_cursor *cursor, sqlite3_int64 *rowid) {
+        *rowid = ((Cursor*) cursor)->row + 1;
+        return SQLITE_OK;
+    }
+
+    static inline sqlite3_module module = {
+        .iVersion = 0,
+        .xConnect = connect,
+        .xBestIndex = best_index,
+        .xDisconnect = disconnect,
+        .xOpen = open,
+        .xClose = close,
+        .xFilter = filter,
+        .xNext = next,
+        .xEof = eof,
+        .xColumn = column,
+        .xRowid = rowid,
+    };
+};
+
+template<class Table>
+void create_eponymous_table(sqlite3 *db, const char *name) {
+    int rc = sqlite3_create_module(db, name, &EponymousTable<Table>::module, nullptr);
+    if(rc != SQLITE_OK) throw std::runtime_error("failed to create virtual table module");
+}
+
+}
@@ -0,0 +1,94 @@
+-- Benchmark: aggregates maintained by createAggregate() under constant churn, next to the
+-- full scans they replace. Each frame moves, damages, kills and spawns entities, then compares
+-- every aggregate with its scan and exits with an error if any of them differ.
+
+create table if not exists entities(
+    id integer primary key,
+    alive int not null default(1),
+    x real not null default(0),
+    vx real not null default(0),
+    affiliation int,
+    contactDamage real,
+    health real,
+    scoreForKill int
+) strict;
+
+select seedRandom(seed) from bench;
+
+insert into entities(x, vx, affiliation, contactDamage, health, scoreForKill)
+with recursive n(i) as (
+    select 1
+    union all
+    select i+1 from n, bench where i < bench.entities
+)
+select randomFloat(-1, 1), randomFloat(-1, 1), i % 3,
+    iif(i % 2, 10, null), iif(i % 4, 100, null), iif(i % 5 = 0, i % 7, null)
+from n
+where not exists (select * from entities);
+
+select
+    createAggregate('alive', 'entities', 'count(*)', 'alive'),
+    createAggregate('byAffiliation', 'entities', 'count(*)', 'alive', 'affiliation'),
+    createAggregate('withContactDamage', 'entities', 'count(*)', 'alive and contactDamage is not null'),
+    createAggregate('killScore', 'entities', 'sum(scoreForKill)', 'alive and health = 0'),
+    createAggregate('healthByAffiliation', 'entities', 'sum(health)', 'alive', 'affiliation');
+
+------------------------------------------- MAIN LOOP ---------------------------------------------
+-- @main-loop
+
+update entities
+set x = x + vx * :dt;
+
+-- Damage a few percent of the entities, kill the ones at zero, revive some dead ones
+update entities
+set health = max(0, health - 50)
+where health is not null and randomFloat() < 0.02;
+
+update entities
+set alive = 0
+where alive and health = 0 and randomFloat() < 0.5;
+
+update entities
+set alive = 1, health = 100
+where not alive and randomFloat() < 0.05;
+
+delete from entities
+where randomFloat() < 0.01;
+
+insert into entities(x, vx, affiliation, contactDamage, health, scoreForKill)
+select randomFloat(-1, 1), randomFloat(-1, 1), abs(random()) % 3, 10, 100, 3
+from entities
+where randomFloat() < 0.01;
+
+-- Incremental
+select aggregate('alive'), aggregate('withContactDamage'), aggregate('killScore'), aggregate('healthByAffiliation');
+select key, value from aggregate_groups where name = 'byAffiliation';
+
+-- Full scans
+select count(*) from entities where alive;
+select count(*) from entities where alive and contactDamage is not null;
+select sum(scoreForKill) from entities where alive and health = 0;
+select sum(health) from entities where alive;
+select affiliation, count(*) from entities where alive group by affiliation;
+
+select logMessage('error', 'aggregate mismatch: ' || name), exit(1)
+from (
+    select 'alive' as name where aggregate('alive') is not (select count(*) from entities where alive)
+    union all
+    select 'withContactDamage' where aggregate('withContactDamage')
+        is not (select count(*) from entities where alive and contactDamage is not null)
+    union all
+    select 'killScore' where aggregate('killScore')
+        is not (select sum(scoreForKill) from entities where alive and health = 0)
+    union all
+    select 'healthByAffiliation' where aggregate('healthByAffiliation')
+        is not (select sum(health) from entities where alive)
+    union all
+    select 'healthByAffiliation/' || affiliation from entities where alive group by affiliation
+        having aggregate('healthByAffiliation', affiliation) is not sum(health)
+    union all
+    select 'byAffiliation' where
+        (select group_concat(key || ':' || value) from aggregate_groups where name = 'byAffiliation')
+        is not (select group_concat(affiliation || ':' || n) from
+            (select affiliation, count(*) as n from entities where alive group by affiliation order by affiliation))
+);
@@ -0,0 +1,64 @@
+-- Benchmark: chain-reaction explosions on a grid of mines.
+-- A few mines go off every frame and set off the armed mines next to them, which set off their
+-- neighbours in turn. The spreading runs in a `-- @repeat until-unchanged` block: each pass only
+-- touches the mines that just went off, and the host stops once a pass changes nothing.
+
+create table if not exists entities(
+    id integer primary key,
+    gx int not null,
+    gy int not null,
+    state int not null default(0)   -- 0 armed, 1 exploding this pass, 2 spent, 3 exploding next pass
+) strict;
+
+create index if not exists entities_cell on entities(gx, gy);
+create index if not exists entities_state on entities(state);
+
+select seedRandom(seed) from bench;
+
+-- About a third of the cells hold a mine, below the density where one chain takes the whole grid
+insert into entities(gx, gy)
+with recursive n(i) as (
+    select 0 where not exists (select * from entities)
+    union all
+    select i+1 from n, bench where i+1 < bench.entities * 3
+)
+select i % cast(sqrt(bench.entities * 3) as int), i / cast(sqrt(bench.entities * 3) as int)
+from n, bench
+where randomFloat(0, 1) < 1.0/3;
+
+------------------------------------------- MAIN LOOP ---------------------------------------------
+-- @main-loop
+
+-- Set some mines off
+update entities
+set state = 1
+where state = 0
+and id in (
+    with recursive n(i) as (
+        select 1
+        union all
+        select i+1 from n, bench where i < max(1, bench.entities / 1000)
+    )
+    select cast(randomFloat(1, (select max(id) from entities)) as int) from n
+);
+
+-- @repeat until-unchanged max=1000
+update entities
+set state = 3
+where state = 0
+and id in (
+    select m.id
+    from entities f join entities m
+    on m.gx in (f.gx - 1, f.gx, f.gx + 1)
+    and m.gy between f.gy - 1 and f.gy + 1
+    where f.state = 1
+);
+
+update entities set state = 2 where state = 1;
+update entities set state = 1 where state = 3;
+-- @endrepeat
+
+-- Re-arm some spent mines so there is something left to explode
+update entities
+set state = 0
+where state = 2 and randomFloat(0, 1) < 0.05;
@@ -0,0 +1,78 @@
+-- Benchmark: the collision and damage logic from game.sql with many entities.
+-- Entities are split between two affiliations and wander around; every overlapping pair
+-- of opposing entities produces a damage event. Dead entities respawn somewhere else.
+
+create table if not exists entities(
+    id integer primary key,
+    x real not null,
+    y real not null,
+    vx real not null,
+    vy real not null,
+    sx real not null default(0.02),
+    sy real not null default(0.02),
+    affiliation int,
+    contactDamage real,
+    health real,
+    maxHealth real,
+    iframes real not null default(0)
+) strict;
+
+create virtual table if not exists damageEvents using frame_table(
+    target_id integer indexed,
+    attacker_id integer,
+    damage real
+);
+
+select seedRandom(seed) from bench;
+
+insert into entities(x, y, vx, vy, affiliation, contactDamage, health, maxHealth)
+with recursive n(i) as (
+    select 1
+    union all
+    select i+1 from n, bench where i < bench.entities
+)
+select randomFloat(-1, 1), randomFloat(-1, 1), randomFloat(-0.2, 0.2), randomFloat(-0.2, 0.2), i % 2, 10, 100, 100
+from n
+where not exists (select * from entities);
+
+------------------------------------------- MAIN LOOP ---------------------------------------------
+-- @main-loop
+
+update entities
+set x = x + vx * :dt,
+    y = y + vy * :dt,
+    iframes = max(0, iframes - :dt);
+
+update entities
+set vx = -vx
+where (x < -1 and vx < 0) or (x > 1 and vx > 0);
+
+update entities
+set vy = -vy
+where (y < -1 and vy < 0) or (y > 1 and vy > 0);
+
+-- Projectile collision test
+insert into damageEvents(target_id, attacker_id, damage)
+select tgt.id, atk.id, atk.contactDamage
+from entities tgt cross join entities atk
+where tgt.health is not null
+and tgt.iframes <= 0
+and atk.contactDamage is not null
+and atk.affiliation <> tgt.affiliation
+and max(tgt.x-tgt.sx/2, atk.x-atk.sx/2) <= min(tgt.x+tgt.sx/2, atk.x+atk.sx/2)
+and max(tgt.y-tgt.sy/2, atk.y-atk.sy/2) <= min(tgt.y+tgt.sy/2, atk.y+atk.sy/2);
+
+-- Apply damage by looking the hit entities up from the events, rather than scanning every entity
+-- @hot
+update entities
+set iframes = iframes + 0.25,
+    health = max(0, health - hits.damage)
+from (select target_id, max(damage) as damage from damageEvents group by target_id) as hits
+where entities.id = hits.target_id;
+
+-- Respawn dead entities instead of deleting them, so the entity count stays fixed
+update entities
+set x = randomFloat(-1, 1),
+    y = randomFloat(-1, 1),
+    health = maxHealth
+where health <= 0;
@@ -0,0 +1,40 @@
+-- Benchmark: entities moving around and bouncing off the edges of the screen.
+-- Run with sqhell_bench, which creates bench(entities, seed) before loading the script
+-- and binds :t and :dt for a fixed 60 Hz step.
+
+create table if not exists entities(
+    id integer primary key,
+    x real not null,
+    y real not null,
+    vx real not null,
+    vy real not null,
+    sx real not null default(0.01),
+    sy real not null default(0.01)
+) strict;
+
+select seedRandom(seed) from bench;
+
+insert into entities(x, y, vx, vy)
+with recursive n(i) as (
+    select 1
+    union all
+    select i+1 from n, bench where i < bench.entities
+)
+select randomFloat(-1, 1), randomFloat(-1, 1), randomFloat(-0.5, 0.5), randomFloat(-0.5, 0.5)
+from n
+where not exists (select * from entities);
+
+------------------------------------------- MAIN LOOP ---------------------------------------------
+-- @main-loop
+
+update entities
+set x = x + vx * :dt,
+    y = y + vy * :dt;
+
+update entities
+set vx = -vx
+where (x < -1 and vx < 0) or (x > 1 and vx > 0);
+
+update entities
+set vy = -vy
+where (y < -1 and vy < 0) or (y > 1 and vy > 0);
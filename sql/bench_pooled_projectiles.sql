@@ -0,0 +1,75 @@
+-- Benchmark: bench_projectiles.sql with pooled projectile slots.
+-- Dead projectiles stay in the table with alive = 0 and spawn() hands their ids to new ones,
+-- so the table stops growing once the population settles and compares directly to plain insert/delete.
+
+create table if not exists entities(
+    id integer primary key,
+    alive int not null default(1),
+    x real not null default(0),
+    y real not null default(0),
+    vx real not null default(0),
+    vy real not null default(0),
+    sx real not null default(0.01),
+    sy real not null default(0.01),
+    reloadLeft real,
+    reloadTime real,
+    age real not null default(0),
+    maxAge real,
+    deleteOutOfBounds int not null default(0)
+) strict;
+
+create index if not exists entities_alive on entities(id) where alive;
+
+select seedRandom(seed) from bench;
+
+insert into entities(x, y, reloadLeft, reloadTime)
+with recursive n(i) as (
+    select 1
+    union all
+    select i+1 from n, bench where i < max(1, bench.entities / 10)
+)
+select randomFloat(-0.9, 0.9), randomFloat(-0.9, 0.9), randomFloat(0, 0.1), 0.1
+from n
+where not exists (select * from entities);
+
+------------------------------------------- MAIN LOOP ---------------------------------------------
+-- @main-loop
+
+-- Shooting
+insert into entities(id, x, y, vx, vy, maxAge, deleteOutOfBounds)
+select spawn('entities'), x, y, randomFloat(-1, 1), randomFloat(-1, 1), 1.0, 1
+from entities
+where alive and reloadLeft is not null and reloadLeft <= :dt
+on conflict(id) do update
+set alive = 1, x = excluded.x, y = excluded.y, vx = excluded.vx, vy = excluded.vy,
+    sx = excluded.sx, sy = excluded.sy, reloadLeft = null, reloadTime = null,
+    age = 0, maxAge = excluded.maxAge, deleteOutOfBounds = excluded.deleteOutOfBounds;
+
+update entities
+set reloadLeft = reloadLeft + reloadTime
+where alive and reloadLeft is not null and reloadLeft <= :dt;
+
+-- Apply velocity, increase age, reload weapon
+update entities
+set x = x + vx * :dt,
+    y = y + vy * :dt,
+    age = age + :dt,
+    reloadLeft = max(0, reloadLeft - :dt)
+where alive;
+
+update entities
+set alive = 0
+where alive and age >= maxAge
+returning despawn('entities', id);
+
+update entities
+set alive = 0
+where alive
+and deleteOutOfBounds
+and (
+    x+sx/2 < -1 or
+    x-sx/2 > 1 or
+    y+sy/2 < -1 or
+    y-sy/2 > 1
+)
+returning despawn('entities', id);
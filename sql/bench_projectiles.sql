@@ -0,0 +1,62 @@
+-- Benchmark: shooters spawning projectiles in random directions.
+-- One in ten entities is a shooter firing every 0.1 s and projectiles live for 1 s,
+-- so the population settles at roughly bench.entities.
+
+create table if not exists entities(
+    id integer primary key,
+    x real not null default(0),
+    y real not null default(0),
+    vx real not null default(0),
+    vy real not null default(0),
+    sx real not null default(0.01),
+    sy real not null default(0.01),
+    reloadLeft real,
+    reloadTime real,
+    age real not null default(0),
+    maxAge real,
+    deleteOutOfBounds int not null default(0)
+) strict;
+
+select seedRandom(seed) from bench;
+
+insert into entities(x, y, reloadLeft, reloadTime)
+with recursive n(i) as (
+    select 1
+    union all
+    select i+1 from n, bench where i < max(1, bench.entities / 10)
+)
+select randomFloat(-0.9, 0.9), randomFloat(-0.9, 0.9), randomFloat(0, 0.1), 0.1
+from n
+where not exists (select * from entities);
+
+------------------------------------------- MAIN LOOP ---------------------------------------------
+-- @main-loop
+
+-- Shooting
+insert into entities(x, y, vx, vy, maxAge, deleteOutOfBounds)
+select x, y, randomFloat(-1, 1), randomFloat(-1, 1), 1.0, 1
+from entities
+where reloadLeft is not null and reloadLeft <= :dt;
+
+update entities
+set reloadLeft = reloadLeft + reloadTime
+where reloadLeft is not null and reloadLeft <= :dt;
+
+-- Apply velocity, increase age, reload weapon
+update entities
+set x = x + vx * :dt,
+    y = y + vy * :dt,
+    age = age + :dt,
+    reloadLeft = max(0, reloadLeft - :dt);
+
+delete from entities
+where age >= maxAge;
+
+delete from entities
+where deleteOutOfBounds
+and (
+    x+sx/2 < -1 or
+    x-sx/2 > 1 or
+    y+sy/2 < -1 or
+    y-sy/2 > 1
+);
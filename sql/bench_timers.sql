@@ -0,0 +1,76 @@
+-- Benchmark: bench_pooled_projectiles.sql with reloads and projectile lifetimes on the timer wheel.
+-- Nothing counts down per row: shooters fire when their 'reload' timer comes out of fired_timers,
+-- projectiles die when their 'expire' timer does, and only movement still touches every row.
+
+create table if not exists entities(
+    id integer primary key,
+    alive int not null default(1),
+    x real not null default(0),
+    y real not null default(0),
+    vx real not null default(0),
+    vy real not null default(0),
+    sx real not null default(0.01),
+    sy real not null default(0.01),
+    reloadTime real,
+    deleteOutOfBounds int not null default(0)
+) strict;
+
+create index if not exists entities_alive on entities(id) where alive;
+
+select seedRandom(seed) from bench;
+
+insert into entities(x, y, reloadTime)
+with recursive n(i) as (
+    select 1
+    union all
+    select i+1 from n, bench where i < max(1, bench.entities / 10)
+)
+select randomFloat(-0.9, 0.9), randomFloat(-0.9, 0.9), 0.1
+from n
+where not exists (select * from entities)
+returning scheduleTimer(id, 'reload', randomFloat(0, 0.1));
+
+------------------------------------------- MAIN LOOP ---------------------------------------------
+-- @main-loop
+
+select advanceTimers(:t);
+
+-- Shooting
+-- @hot
+insert into entities(id, x, y, vx, vy, deleteOutOfBounds)
+select spawn('entities'), x, y, randomFloat(-1, 1), randomFloat(-1, 1), 1
+from entities
+where id in (select entity_id from fired_timers where kind = 'reload')
+on conflict(id) do update
+set alive = 1, x = excluded.x, y = excluded.y, vx = excluded.vx, vy = excluded.vy,
+    sx = excluded.sx, sy = excluded.sy, reloadTime = null, deleteOutOfBounds = excluded.deleteOutOfBounds
+returning scheduleTimer(id, 'expire', 1.0);
+
+-- @hot
+select scheduleTimer(id, 'reload', reloadTime)
+from entities
+where id in (select entity_id from fired_timers where kind = 'reload');
+
+-- Apply velocity
+update entities
+set x = x + vx * :dt,
+    y = y + vy * :dt
+where alive;
+
+-- @hot
+update entities
+set alive = 0
+where alive and id in (select entity_id from fired_timers where kind = 'expire')
+returning despawn('entities', id);
+
+update entities
+set alive = 0
+where alive
+and deleteOutOfBounds
+and (
+    x+sx/2 < -1 or
+    x-sx/2 > 1 or
+    y+sy/2 < -1 or
+    y-sy/2 > 1
+)
+returning despawn('entities', id), cancelTimers(id);
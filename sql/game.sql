@@ -7,8 +7,6 @@ create table if not exists vars(
     t           real,                       -- time when last frame started
     dt          real not null default(0.16),-- duration of last frame
 
-    vertexShader int,
-    fragmentShader int,
     shaderProgram int,
     vbo int,
     vao int,
@@ -37,6 +35,7 @@ create table if not exists sqlvars(
 -- We're doing ECS since it's basically a simplified version of the relational model
 create table if not exists entities(
     id integer primary key,
+    alive int not null default(1),  -- dead rows are kept for spawn() to reuse
     x real not null default(0),     -- position
     y real not null default(0),
     vx real not null default(0),    -- velocity
@@ -46,38 +45,39 @@ create table if not exists entities(
     isPlayer int not null default(0),
     keepInBounds int not null default(0),
     deleteOutOfBounds int not null default(0),
-    reloadLeft real not null default(0),
+    reloading int not null default(0),  -- until its 'reload' timer fires
     reloadTime real not null default(0.3),
     isShooting int not null default(0),
     affiliation int,
     contactDamage real,
     health real,
     maxHealth real,
-    iframes real not null default(0),
-    age real not null default(0),
-    maxAge real,
+    invulnerable int not null default(0),  -- until its 'iframes' timer fires
+    maxAge real,                    -- gets an 'expire' timer when spawned
     hitCap int,
     scoreForKill int
 ) strict;
 
-create table if not exists damageEvents(
-    target_id integer,
-    attacker_id integer,
+create index if not exists entities_alive on entities(id) where alive;
+
+-- Statistics kept up to date as entities change, instead of scanning them every frame
+select
+    createAggregate('entities', 'entities', 'count(*)', 'alive'),
+    createAggregate('deadEntities', 'entities', 'count(*)', 'not alive'),
+    createAggregate('entitiesByAffiliation', 'entities', 'count(*)', 'alive', 'affiliation'),
+    createAggregate('withContactDamage', 'entities', 'count(*)', 'alive and contactDamage is not null'),
+    createAggregate('withHealth', 'entities', 'count(*)', 'alive and health is not null'),
+    createAggregate('players', 'entities', 'count(*)', 'alive and isPlayer'),
+    createAggregate('readyToShoot', 'entities', 'count(*)', 'alive and isShooting and not reloading'),
+    createAggregate('killScore', 'entities', 'sum(scoreForKill)', 'alive and health = 0');
+
+-- Cleared at the start of every frame
+create virtual table if not exists damageEvents using frame_table(
+    target_id integer indexed,
+    attacker_id integer indexed,
     damage real
 );
 
--- Rectangles drawn on screen
-create table if not exists rects(
-    x real not null,
-    y real not null,
-    sx real not null,
-    sy real not null,
-    r real not null,
-    g real not null,
-    b real not null,
-    a real not null
-) strict;
-
 --------------------------------------------- SETUP -----------------------------------------------
 
 create trigger if not exists setup
@@ -96,26 +96,10 @@ begin
     update vars
     set vbo = glCreateBuffer(),
         vao = glCreateVertexArray(),
-        vertexShader = glCreateShader(GL_VERTEX_SHADER()),
-        fragmentShader = glCreateShader(GL_FRAGMENT_SHADER()),
-        shaderProgram = glCreateProgram();
-
-    select
-        glShaderSource(vertexShader, readFileText("shaders/color.vert")),
-        glShaderSource(fragmentShader, readFileText("shaders/color.frag"))
-    from vars;
-
-    select 
-        glCompileShader(vertexShader), 
-        glCompileShader(fragmentShader)
-    from vars;
-
-    select 
-        glAttachShader(shaderProgram, vertexShader), 
-        glAttachShader(shaderProgram, fragmentShader)
-    from vars;
-
-    select glLinkProgram(shaderProgram) from vars;
+        shaderProgram = buildProgram(
+            readFileText("shaders/color.vert"),
+            readFileText("shaders/color.frag")
+        );
 
     select 
         glBindVertexArray(vao), 
@@ -135,7 +119,9 @@ begin
     -- Insert an enemy
     insert into entities(x,y,contactDamage,affiliation,health,maxHealth, scoreForKill) values(0, 0.5, 10, 1, 100, 100, 100);
 
-    update vars set t = glfwGetTime() - dt;
+    -- The main loop reads these as host parameters instead of joining vars
+    select setParam('pWindow', pWindow), setParam('shaderProgram', shaderProgram), setParam('vbo', vbo)
+    from vars;
 end;
 
 -- Ensure there is a row in vars
@@ -148,12 +134,12 @@ select ''
 where (select count(*) from sqlvars) = 0;
 
 ------------------------------------------- MAIN LOOP ---------------------------------------------
+-- @main-loop
 
 -- Exit condition
 
 select exit(0)
-from vars
-where glfwWindowShouldClose(pWindow);
+where glfwWindowShouldClose(:pWindow);
 
 -- GUI BOILERPLATE
 
@@ -161,27 +147,25 @@ select ImGui_ImplOpenGL3_NewFrame();
 select ImGui_ImplGlfw_NewFrame();
 select ImGuiNewFrame();
 
--- GUI
+-- GUI, skipped while the window is collapsed
 
-select ImGuiBegin("Statistics");
+-- @if ImGuiBegin("Statistics")
 
     select ImGuiLabel("Score", totalScore)
     from vars;
 
-    select ImGuiLabel("Total entities", count(*)) 
-    from entities;
+    select ImGuiLabel("Total entities", aggregate('entities'));
+
+    select ImGuiLabel("Dead entity slots", aggregate('deadEntities'));
 
-    select ImGuiLabel("Affiliation "||affiliation, count(*)) 
-    from entities group by affiliation order by affiliation;
+    select ImGuiLabel("Affiliation "||key, value) 
+    from aggregate_groups where name = 'entitiesByAffiliation';
 
-    select ImGuiLabel("With contact damage", count(*)) 
-    from entities where contactDamage is not null;
+    select ImGuiLabel("With contact damage", aggregate('withContactDamage'));
 
-    select ImGuiLabel("With health", count(*)) 
-    from entities where health is not null;
+    select ImGuiLabel("With health", aggregate('withHealth'));
 
-    select ImGuiLabel("Player controlled", count(*)) 
-    from entities where isPlayer;
+    select ImGuiLabel("Player controlled", aggregate('players'));
 
     update sqlvars
     set cmd = ImGuiInputTextMultiline("SQL command", cmd);
@@ -193,160 +177,159 @@ select ImGuiBegin("Statistics");
     select ImGuiInputTextMultiline("SQL command result", cmdResult)
     from sqlvars;
 
+-- @endif
 select ImGuiEnd();
 
 -- GAME UPDATE
 
--- Delta T management
-update vars 
-set dt = glfwGetTime() - t, 
-    t  = glfwGetTime();
+-- The host binds the frame's time to :t and :dt, vars keeps a copy for SQL commands
+update vars
+set dt = :dt,
+    t  = :t;
+
+-- Timers that came due: cooldowns end here, expired entities die with the others below
+select advanceTimers(:t);
+-- @if exists (select * from fired_timers)
+-- @hot
+update entities set reloading = 0 where id in (select entity_id from fired_timers where kind = 'reload');
+-- @hot
+update entities set invulnerable = 0 where id in (select entity_id from fired_timers where kind = 'iframes');
+-- @endif
 
 -- Control player
-update entities set vx=0, vy=0 where isPlayer;
+update entities set vx=0, vy=0 where alive and isPlayer;
 
 update entities
 set vx = vx + iif(inputs.left, -1, 0) + iif(inputs.right, 1, 0),
     vy = vy + iif(inputs.down, -1, 0) + iif(inputs.up,    1, 0),
     isShooting = inputs.shoot
 from inputs
-where isPlayer;
+where alive and isPlayer;
 
-update entities
-set vx = cos(atan2(vy,vx)) * 0.5,
-    vy = sin(atan2(vy,vx)) * 0.5
-where isPlayer and (vx <> 0 or vy <> 0);
-
--- Shooting
-insert into entities(affiliation, contactDamage, deleteOutOfBounds, hitCap, x, y, sx, sy, vy)
+-- Shooting, into the slot of a dead entity when there is one
+-- @if aggregate('readyToShoot') > 0
+insert into entities(id, affiliation, contactDamage, deleteOutOfBounds, hitCap, x, y, sx, sy, vy)
 select 
-    affiliation, 10, 1, 1, x, y, 0.05, 0.05,
+    spawn('entities'), affiliation, 10, 1, 1, x, y, 0.05, 0.05,
     case affiliation when 0 then 1 else -0.5 end
-from entities, vars
-where isShooting and reloadLeft <= dt;
+from entities
+where alive and isShooting and not reloading
+on conflict(id) do update set
+    (alive, x, y, vx, vy, sx, sy, isPlayer, keepInBounds, deleteOutOfBounds, reloading, reloadTime, isShooting,
+     affiliation, contactDamage, health, maxHealth, invulnerable, maxAge, hitCap, scoreForKill)
+  = (excluded.alive, excluded.x, excluded.y, excluded.vx, excluded.vy, excluded.sx, excluded.sy,
+     excluded.isPlayer, excluded.keepInBounds, excluded.deleteOutOfBounds, excluded.reloading, excluded.reloadTime,
+     excluded.isShooting, excluded.affiliation, excluded.contactDamage, excluded.health, excluded.maxHealth,
+     excluded.invulnerable, excluded.maxAge, excluded.hitCap, excluded.scoreForKill)
+returning scheduleTimer(id, 'expire', maxAge);
 
 update entities
-set reloadLeft = reloadLeft + reloadTime
-from vars
-where isShooting and reloadLeft <= dt;
+set reloading = 1
+where alive and isShooting and not reloading
+returning scheduleTimer(id, 'reload', reloadTime);
+-- @endif
 
--- Apply velocity, increase age, reload weapon
+-- Normalize player speed, apply velocity and keep some entities in bounds.
+-- The three statements are adjacent so that --fuse-updates merges them.
 update entities
-set x = x + vx * dt,
-    y = y + vy * dt,
-    age = age + dt,
-    iframes = max(0, iframes - dt),
-    reloadLeft = max(0, reloadLeft - dt)
-from vars;
+set vx = cos(atan2(vy,vx)) * 0.5,
+    vy = sin(atan2(vy,vx)) * 0.5
+where alive and isPlayer and (vx <> 0 or vy <> 0);
+
+update entities
+set x = x + vx * :dt,
+    y = y + vy * :dt
+where alive;
 
--- Keep some entities in bounds
 update entities
 set x = max(sx/2-1, min(x, 1-sx/2)),
     y = max(sy/2-1, min(y, 1-sy/2))
-where keepInBounds;
+where alive and keepInBounds;
 
 -- Projectile collision test
 insert into damageEvents(target_id, attacker_id, damage)
 select tgt.id, atk.id, atk.contactDamage
 from entities tgt cross join entities atk
-where tgt.health is not null
-and tgt.iframes <= 0
+where tgt.alive and atk.alive
+and tgt.health is not null
+and not tgt.invulnerable
 and atk.contactDamage is not null
 and atk.affiliation <> tgt.affiliation
 and max(tgt.x-tgt.sx/2, atk.x-atk.sx/2) <= min(tgt.x+tgt.sx/2, atk.x+atk.sx/2)
 and max(tgt.y-tgt.sy/2, atk.y-atk.sy/2) <= min(tgt.y+tgt.sy/2, atk.y+atk.sy/2);
 
+-- Apply damage by looking the hit entities up from the events, rather than scanning every entity
+-- @if exists (select * from damageEvents)
+-- @hot
 update entities
-set iframes = iframes + 0.25,
-    health = max(0, health - (
-        select max(damage)
-        from damageEvents
-        where target_id = id
-    ))
-where exists (select target_id from damageEvents where target_id = id);
+set invulnerable = 1,
+    health = max(0, health - hits.damage)
+from (select target_id, max(damage) as damage from damageEvents group by target_id) as hits
+where entities.id = hits.target_id
+returning scheduleTimer(entities.id, 'iframes', 0.25);
 
+-- @hot
 update entities
 set hitCap = max(0, hitCap-1)
-where hitCap is not null 
-and exists (select attacker_id from damageEvents where attacker_id = id);
-
-delete from damageEvents;
+where id in (select attacker_id from damageEvents)
+and hitCap is not null;
+-- @endif
 
 -- Increase score for killed entities
 update vars
-set totalScore = totalScore + coalesce((
-    select sum(scoreForKill)
-    from entities
-    where health = 0 and scoreForKill is not null
-), 0);
-
--- Delete entities where applicable
-delete from entities
-where health <= 0
-or age >= maxAge
-or hitCap = 0;
-
-delete from entities
-where deleteOutOfBounds
+set totalScore = totalScore + coalesce(aggregate('killScore'), 0);
+
+-- Kill entities where applicable, their slots go back to the pool and their timers are dropped
+update entities
+set alive = 0
+where alive
+and (health <= 0 or hitCap = 0 or id in (select entity_id from fired_timers where kind = 'expire'))
+returning despawn('entities', id), cancelTimers(id);
+
+update entities
+set alive = 0
+where alive
+and deleteOutOfBounds
 and (
     x+sx/2 < -1 or
     x-sx/2 > 1 or
     y+sy/2 < -1 or
     y-sy/2 > 1
-);
+)
+returning despawn('entities', id), cancelTimers(id);
 
 -- GAME RENDER
 
 select glClearColor(
-    (sin(t)+1)/2, 
-    (sin(t+pi()*2/3)+1)/2, 
-    (sin(t+pi()*4/3)+1)/2
-) from vars;
+    (sin(:t)+1)/2,
+    (sin(:t+pi()*2/3)+1)/2,
+    (sin(:t+pi()*4/3)+1)/2
+);
 select glClear(GL_COLOR_BUFFER_BIT());
 
-select glUseProgram(shaderProgram) from vars;
+select glUseProgram(:shaderProgram);
 
--- Draw entities
-insert into rects(x,y,sx,sy,r,g,b,a)
-select x,y,sx,sy,1,1,1,1 from entities;
-
--- Draw health bars
-insert into rects(x,y,sx,sy,r,g,b,a)
-select x, y-0.7*sy, sx, 0.2*sy, 0,0,0,1 
-from entities
-where health is not null and maxHealth is not null;
+-- Draw entities, then health bars on top of them
+select emitRect(x,y,sx,sy,1,1,1,1) from entities where alive;
 
-insert into rects(x,y,sx,sy,r,g,b,a)
-select x, y-0.7*sy, (sx-0.1*sy)*health/maxHealth, 0.1*sy, 1-health/maxHealth, health/maxHealth, 0, 1
+select
+    emitRect(x, y-0.7*sy, sx, 0.2*sy, 0,0,0,1),
+    emitRect(x, y-0.7*sy, (sx-0.1*sy)*health/maxHealth, 0.1*sy, 1-health/maxHealth, health/maxHealth, 0, 1)
 from entities
-where health is not null and maxHealth is not null;
+where alive and health is not null and maxHealth is not null;
 
-select pushFloats(
-    x-sx/2, y-sy/2, r,g,b,a,
-    x+sx/2, y-sy/2, r,g,b,a,
-    x-sx/2, y+sy/2, r,g,b,a,
-    x+sx/2, y-sy/2, r,g,b,a,
-    x-sx/2, y+sy/2, r,g,b,a,
-    x+sx/2, y+sy/2, r,g,b,a
-) from rects;
-
-select glNamedBufferData(
-    vbo, count(*)*6*24, 
-    getFloats(), GL_STREAM_DRAW()
-) from rects, vars;
-
-select clearFloats();
-
-select glDrawArrays(GL_TRIANGLES(), 0, count(*)*6) from rects;
-delete from rects;
+select gpuTimerBegin("entities");
+select flushDrawList(:vbo);
+select gpuTimerEnd();
 
 select ImGuiRender();
+select gpuTimerBegin("imgui");
 select ImGui_ImplOpenGL3_RenderDrawData(ImGuiGetDrawData());
+select gpuTimerEnd();
 
 -- Polling etc
 
-select glfwSwapBuffers(pWindow)
-from vars;
+select glfwSwapBuffers(:pWindow);
 
 select glfwPollEvents();
 
@@ -0,0 +1,78 @@
+// Packs asset directories into a single archive readable by sqhell --archive.
+// Usage: sqhell_pack <output> <root dir> <dir or file relative to root>...
+#include <archive.h>
+#include <filesystem>
+#include <fstream>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+
+namespace fs = std::filesystem;
+namespace rn = std::ranges;
+
+int main(int argc, char **argv) {
+    if(argc < 4) {
+        fprintf(stderr, "Usage: %s <output> <root dir> <inputs...>\n", *argv);
+        return EXIT_FAILURE;
+    }
+    fs::path root = argv[2];
+
+    std::vector<std::string> paths;
+    for(int i = 3; i < argc; ++i) {
+        fs::path input = root / argv[i];
+        if(fs::is_directory(input)) {
+            for(auto &entry : fs::recursive_directory_iterator(input))
+                if(entry.is_regular_file())
+                    paths.push_back(fs::relative(entry.path(), root).generic_string());
+        } else {
+            paths.push_back(fs::path(argv[i]).generic_string());
+        }
+    }
+    rn::sort(paths);
+    paths.erase(std::unique(paths.begin(), paths.end()), paths.end());
+
+    std::vector<std::string> contents;
+    for(auto &path : paths) {
+        std::ifstream fin(root / path, std::ios::binary);
+        if(!fin) {
+            fprintf(stderr, "Failed to read %s\n", path.c_str());
+            return EXIT_FAILURE;
+        }
+        contents.emplace_back(std::istreambuf_iterator<char>(fin), std::istreambuf_iterator<char>());
+    }
+
+    sqhell::ArchiveHeader header{};
+    memcpy(header.magic, sqhell::ARCHIVE_MAGIC, sizeof(header.magic));
+    header.count = paths.size();
+
+    std::vector<sqhell::ArchiveEntry> entries(paths.size());
+    uint64_t offset = sizeof(header) + entries.size() * sizeof(sqhell::ArchiveEntry);
+    for(size_t i = 0; i < paths.size(); ++i) {
+        entries[i].path_offset = offset;
+        entries[i].path_size = paths[i].size();
+        offset += paths[i].size();
+    }
+    for(size_t i = 0; i < paths.size(); ++i) {
+        offset = (offset + 15) & ~uint64_t(15);
+        entries[i].data_offset = offset;
+        entries[i].data_size = contents[i].size();
+        offset += contents[i].size() + 1;
+    }
+
+    std::ofstream fout(argv[1], std::ios::binary);
+    fout.write((const char*) &header, sizeof(header));
+    fout.write((const char*) entries.data(), entries.size() * sizeof(sqhell::ArchiveEntry));
+    for(auto &path : paths) fout.write(path.data(), path.size());
+    for(size_t i = 0; i < paths.size(); ++i) {
+        while((uint64_t)fout.tellp() < entries[i].data_offset) fout.put('\0');
+        fout.write(contents[i].data(), contents[i].size());
+        fout.put('\0');
+    }
+    if(!fout) {
+        fprintf(stderr, "Failed to write %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    printf("Packed %zu files into %s\n", paths.size(), argv[1]);
+}